@@ -24,40 +24,35 @@
 // END LICENSE
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+
 #include "plx2csv.h"
 
 int main (int argc, char *argv[])
 {
 
-	// Plexon specific structs
-	struct PL_FileHeader 		plxFileHeader;
-	struct PL_DataBlockHeader	plxDataBlockHeader;
-	struct PL_ChanHeader 		plxSpikeChannelHeader;
-	struct PL_EventHeader 		plxEventChannelHeader;
-	struct PL_SlowChannelHeader	plxSlowChannelHeader;
-
-	// Plexon file information variables
-	char 	plxDateTime[25];			// date/time when data was acquired
-	char 	plxBitsPerSample;			// Number of bits per sample
-
 	// Options
-	char option_NoHeader     = 0;
-	char option_HeaderFile   = 0;
-	char option_SpikeChannel = 1;
-	char option_EventChannel = 0;
-	char option_SlowChannel  = 0;
+	struct PlxOptions options;
+	struct PlxReport report;
 
-	// misc variables
-	FILE *plexonInFile;					// Plexon input file pointer
-	FILE *csvOutFile;					// CSV output file pointer
-	__int64	timestamp;					// DataBlockHeader time stamp
-	double seconds;						// DataBlockHeader time stamp in seconds
-	
-	char csvOutFileName[255];			// CSV output file name
-	short *pWaveformData = NULL;		// Waveform Data pointer
+	// input files (command line and manifest)
+	char **inputs = NULL;
+	int numInputs = 0, capacity = 0;
+	const char *manifest = NULL;
+	const char *reportFileName = "plx2csv.report.csv";
 
-	int i, cntSpikes = 0, cntEvents = 0, cntSlow = 0;
+	int i, result = 0;
 	
+	memset(&options, 0, sizeof(struct PlxOptions));
+	options.spikeChannel = 1;
+	options.readerMode   = PLX_READER_MMAP;
+	options.threads      = 1;
+	options.jobs         = 1;
+	options.to           = -1;
+	options.progress     = -1;
+	plxFilterInit(&options.filter);
 
 	if (argc < 2) {
 
@@ -66,189 +61,1695 @@ int main (int argc, char *argv[])
 	} else {
 
 		// parse cmd line options
-		for (i = 0; i < argc; i++) {
+		for (i = 1; i < argc; i++) {
+
+			// everything that is not an option is an input file ("-" is stdin)
+			if ((argv[i][0] != '-') || (argv[i][1] == '\0')) {
+				if (addInput(&inputs, &numInputs, &capacity, argv[i]) != 0) result = PLX_ERR_MEMORY;
+				continue;
+			}
 			
 			if (!strcmp("-noheader", argv[i])) {
-				option_NoHeader = 1;
+				options.noHeader = 1;
 			}
 
 			if (!strcmp("-headerfile", argv[i])) {
-				option_NoHeader   = 1;
-				option_HeaderFile = 1;
+				options.noHeader   = 1;
+				options.headerFile = 1;
 			}
 
 			if (!strcmp("-spikechannel", argv[i])) {
-				option_SpikeChannel = 1;
+				options.spikeChannel = 1;
+			}
+
+			if (!strcmp("-eventchannel", argv[i])) {
+				options.spikeChannel = 0;
+				options.eventChannel = 1;
+			}
+
+			if (!strcmp("-slowchannel", argv[i])) {
+				options.spikeChannel = 0;
+				options.slowChannel  = 1;
+			}
+
+			if (!strcmp("-slowbin", argv[i])) {
+				options.spikeChannel = 0;
+				options.slowChannel  = 1;
+				options.slowFormat   = PLX_FORMAT_BIN;
+			}
+
+			if (!strcmp("-format", argv[i]) && (i + 1 < argc)) {
+				i++;
+				if (!strcmp("bin", argv[i])) {
+					options.format     = PLX_FORMAT_BIN;
+					options.slowFormat = PLX_FORMAT_BIN;
+				} else if (!strcmp("csv", argv[i])) {
+					options.format     = PLX_FORMAT_CSV;
+					options.slowFormat = PLX_FORMAT_CSV;
+				}
+			}
+
+			if (!strcmp("-split", argv[i]) && (i + 1 < argc)) {
+				i++;
+				if (!strcmp("channel", argv[i])) options.split = PLX_SPLIT_CHANNEL;
+				else if (!strcmp("unit", argv[i])) options.split = PLX_SPLIT_UNIT;
+			}
+
+			if (!strcmp("-trains", argv[i])) {
+				options.trains = 1;
+			}
+
+			if (!strcmp("-bin", argv[i]) && (i + 1 < argc)) {
+				options.trains   = 1;
+				options.binWidth = atof(argv[++i]) / 1000.0;
+				if (options.binWidth < 0) options.binWidth = 0;
+			}
+
+			if (!strcmp("-features", argv[i])) {
+				options.features = 1;
+			}
+
+			if (!strcmp("-pca", argv[i]) && (i + 1 < argc)) {
+				options.features      = 1;
+				options.pcaComponents = atoi(argv[++i]);
+				if (options.pcaComponents < 0) options.pcaComponents = 0;
+				if (options.pcaComponents > PLX_FEATURES_MAX_PCS) options.pcaComponents = PLX_FEATURES_MAX_PCS;
+			}
+
+			if (!strcmp("-sample", argv[i]) && (i + 1 < argc)) {
+				options.sample = atoi(argv[++i]);
+				if (options.sample < 1) options.sample = 1;
+			}
+
+			if (!strcmp("-seed", argv[i]) && (i + 1 < argc)) {
+				options.seed    = strtoull(argv[++i], NULL, 10);
+				options.hasSeed = 1;
+			}
+
+			if (!strcmp("-scale", argv[i]) && (i + 1 < argc)) {
+				i++;
+				options.scaleMicrovolts = !strcmp("uV", argv[i]);
+			}
+
+			if (!strcmp("-out", argv[i]) && (i + 1 < argc)) {
+				options.outFileName = argv[++i];
+			}
+
+			if (!strcmp("-fread", argv[i])) {
+				options.readerMode = PLX_READER_STDIO;
+			}
+
+			if (!strcmp("-threads", argv[i]) && (i + 1 < argc)) {
+				options.threads = atoi(argv[++i]);
+				if (options.threads < 1) options.threads = 1;
+				if (options.threads > PLX_MAX_THREADS) options.threads = PLX_MAX_THREADS;
+			}
+
+			if (!strcmp("-jobs", argv[i]) && (i + 1 < argc)) {
+				options.jobs = atoi(argv[++i]);
+				if (options.jobs < 1) options.jobs = 1;
+				if (options.jobs > PLX_MAX_THREADS) options.jobs = PLX_MAX_THREADS;
+			}
+
+			if (!strcmp("-budget", argv[i]) && (i + 1 < argc)) {
+				options.budget = (unsigned __int64)(atof(argv[++i]) * 1e6);
+			}
+
+			if (!strcmp("-manifest", argv[i]) && (i + 1 < argc)) {
+				manifest = argv[++i];
+			}
+
+			if (!strcmp("-report", argv[i]) && (i + 1 < argc)) {
+				reportFileName = argv[++i];
+			}
+
+			if (!strcmp("-stats", argv[i]) && (i + 1 < argc)) {
+				i++;
+				if (!strcmp("text", argv[i])) options.stats = PLX_STATS_TEXT;
+				else if (!strcmp("json", argv[i])) options.stats = PLX_STATS_JSON;
+			}
+
+			if (!strcmp("-progress", argv[i]) && (i + 1 < argc)) {
+				options.progress = atof(argv[++i]);
+				if (options.progress < 0) options.progress = 0;
+			}
+
+			if (!strcmp("-resume", argv[i])) {
+				options.resume = 1;
+			}
+
+			if (!strcmp("-follow", argv[i]) && (i + 1 < argc)) {
+				options.follow = atof(argv[++i]);
+				if (options.follow <= 0) options.follow = 1;
+				options.resume = 1;
+			}
+
+			if (!strcmp("-merge", argv[i])) {
+				options.merge = 1;
+			}
+
+			if (!strcmp("-renumber", argv[i]) && (i + 1 < argc)) {
+				options.merge    = 1;
+				options.renumber = argv[++i];
+			}
+
+			if (!strcmp("-index", argv[i])) {
+				options.buildIndex = 1;
+			}
+
+			if (!strcmp("-summary", argv[i])) {
+				options.summary = 1;
+			}
+
+			if (!strcmp("-verify", argv[i])) {
+				options.summary = 1;
+				options.verify  = 1;
+			}
+
+			if (!strcmp("-from", argv[i]) && (i + 1 < argc)) {
+				options.from      = atof(argv[++i]);
+				options.useFilter = 1;
+			}
+
+			if (!strcmp("-to", argv[i]) && (i + 1 < argc)) {
+				options.to        = atof(argv[++i]);
+				options.useFilter = 1;
+			}
+
+			if (!strcmp("-channels", argv[i]) && (i + 1 < argc)) {
+				parseList(&options.filter, argv[++i], plxFilterAddChannel);
+				options.useFilter = 1;
+			}
+
+			if (!strcmp("-units", argv[i]) && (i + 1 < argc)) {
+				parseList(&options.filter, argv[++i], plxFilterAddUnit);
+				options.useFilter = 1;
 			}
 		}
 
+		// -stats prints progress every 2 s unless -progress is given
+		if (options.progress < 0) options.progress = (options.stats != PLX_STATS_NONE) ? 2 : 0;
 
-		// start
-		plexonInFile = fopen(argv[1], "r+b");
-		
-		if (plexonInFile != NULL) {
+		// spike rows only, other blocks are skipped from their header
+		if (!options.eventChannel && !options.slowChannel) options.filter.types = PLX_TYPE_BIT(1);
 
-			// create csv output file from input file name
-			sprintf(csvOutFileName, "%s.csv", argv[1]);
+		if ((manifest != NULL) && (readManifest(&inputs, &numInputs, &capacity, manifest) != 0)) {
+			fprintf(stderr, "Error: Cannot read manifest file '%s'.\n", manifest);
+			result = PLX_ERR_OPEN;
+		}
 
-			// open csv output file name
-			csvOutFile = fopen(csvOutFileName, "w+");
-			if (csvOutFile != NULL) {
-				
-				// read plexon file header
-				fread(&plxFileHeader, 1, sizeof(struct PL_FileHeader), plexonInFile);
+		if (result == PLX_ERR_MEMORY) {
 
-				// exit if header doesn't have magic number
-				if (plxFileHeader.MagicNumber != 0x58454C50) {
-					
-					fprintf(stderr, "Error: Invalid plexon file.\n");
+			fprintf(stderr, "Error: Out of memory.\n");
 
-				} else {
+		} else if (options.merge && (numInputs > 0)) {
 
-					// get date and timestamp from plexon file
-					sprintf(plxDateTime, "%4d-%02d-%02d %02d:%02d:%02d", 
-						plxFileHeader.Year, 
-						plxFileHeader.Month, 
-						plxFileHeader.Day, 
-						plxFileHeader.Hour, 
-						plxFileHeader.Minute, 
-						plxFileHeader.Second);
-
-					// get adc resolution for normalization (usually 12 bits)
-					if (plxFileHeader.BitsPerSpikeSample == 0) plxBitsPerSample = 12;
-					else
-						plxBitsPerSample = plxFileHeader.BitsPerSpikeSample;
-
-					fprintf(stdout, "\nplx2csv version 0.1.1, Copyright (c) 2011 by Gerold Bausch\n");					
-					fprintf(stdout, " PLX File Version (%d) from %s\n", plxFileHeader.Version, plxDateTime);
-
-					#ifdef __DEBUG__
-					fprintf(stdout, " NumDSPChannels    %d\n", plxFileHeader.NumDSPChannels);
-					fprintf(stdout, " NumEventChannels  %d\n", plxFileHeader.NumEventChannels);
-					fprintf(stdout, " NumSlowChannels   %d\n\n", plxFileHeader.NumSlowChannels);	
-
-					fprintf(stdout, " ADFrequency       %d\n", plxFileHeader.ADFrequency);
-					fprintf(stdout, " NumPointsWave     %d\n", plxFileHeader.NumPointsWave);
-					fprintf(stdout, " NumPointsPreThr   %d\n", plxFileHeader.NumPointsPreThr);
-					#endif
-
-					if (option_NoHeader != 1) {
-						fprintf(csvOutFile, "# PLX File Version (%d) from %s\n\n", plxFileHeader.Version, plxDateTime);
-						fprintf(csvOutFile, "# ADFrequency=%d\n", plxFileHeader.ADFrequency);
-						fprintf(csvOutFile, "# NumPointsWave=%d\n", plxFileHeader.NumPointsWave);
-						fprintf(csvOutFile, "# NumPointsPreThr=%d\n\n", plxFileHeader.NumPointsPreThr);
-						fprintf(csvOutFile, "# Time (Seconds); Channel; Unit; Data\n");
-					}
+			// all inputs into one csv file ordered by timestamp
+			result = mergeFiles((const char**) inputs, numInputs, &options, &report);
 
-					// read DSP channel headers (dummy read)
-					for (i = 0; i < plxFileHeader.NumDSPChannels; i++) {			
-						fread(&plxSpikeChannelHeader, sizeof(struct PL_ChanHeader), 1, plexonInFile);
-					}
+		} else if ((options.outFileName != NULL) && ((numInputs > 1) || (manifest != NULL))) {
 
-					// read Event channel headers (dummy read)
-					for (i = 0; i < plxFileHeader.NumEventChannels; i++) {			
-						fread(&plxEventChannelHeader, sizeof(struct PL_EventHeader), 1, plexonInFile);
-					}
+			fprintf(stderr, "Error: Option -out needs a single input file.\n");
+			result = -1;
 
-					// read Slow channel headers (dummy read)
-					for (i = 0; i < plxFileHeader.NumSlowChannels; i++) {			
-						fread(&plxSlowChannelHeader, sizeof(struct PL_SlowChannelHeader), 1, plexonInFile);
-					}
+		} else if ((options.follow > 0) && ((numInputs != 1) || (manifest != NULL))) {
+
+			fprintf(stderr, "Error: Option -follow needs a single input file.\n");
+			result = -1;
+
+		} else if ((numInputs == 1) && (manifest == NULL)) {
+
+			// csv rows of stdin go to stdout unless -out is given
+			if (!strcmp(inputs[0], "-") && (options.outFileName == NULL)) options.outFileName = "-";
+
+
+			// single file, progress on the command line
+			if (options.follow > 0) result = followFile(inputs[0], &options, &report);
+			else result = convertFile(inputs[0], &options, &report);
+
+		} else if (numInputs > 0) {
+
+			// many files on a pool of workers
+			options.quiet = 1;
+			result = convertBatch((const char**) inputs, numInputs, &options, reportFileName);
+
+		} else if (result == 0) {
+
+			printUsage();
+		}
+
+		for (i = 0; i < numInputs; i++) free(inputs[i]);
+		free(inputs);
+	}
+
+	return (result != 0) ? 1 : 0;
+}
+
+// Append a copy of fileName to the input list
+int addInput(char ***inputs, int *numInputs, int *capacity, const char *fileName)
+{
+	char **list;
+
+	if (*numInputs == *capacity) {
+		*capacity = (*capacity > 0) ? 2 * *capacity : 16;
+		list = (char**) realloc (*inputs, *capacity * sizeof(char*));
+		if (list == NULL) return PLX_ERR_MEMORY;
+		*inputs = list;
+	}
+
+	(*inputs)[*numInputs] = strdup(fileName);
+	if ((*inputs)[*numInputs] == NULL) return PLX_ERR_MEMORY;
+	(*numInputs)++;
+
+	return 0;
+}
+
+// Read input file names from a manifest, one per line. Empty lines and
+// lines starting with '#' are ignored.
+int readManifest(char ***inputs, int *numInputs, int *capacity, const char *fileName)
+{
+	FILE *manifestFile;
+	char line[4096];
+	size_t length;
+	int result = 0;
+
+	manifestFile = fopen(fileName, "r");
+	if (manifestFile == NULL) return PLX_ERR_OPEN;
+
+	while ((result == 0) && (fgets(line, sizeof(line), manifestFile) != NULL)) {
+
+		length = strlen(line);
+		while ((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r'))) line[--length] = '\0';
+
+		if ((length == 0) || (line[0] == '#')) continue;
+
+		result = addInput(inputs, numInputs, capacity, line);
+	}
+
+	fclose(manifestFile);
+
+	return result;
+}
+
+// Progress message on the command line, suppressed in batch mode. Goes to
+// stderr while csv rows are written to stdout.
+void printInfo(const struct PlxOptions *options, const char *format, ...)
+{
+	va_list args;
+
+	if (options->quiet) return;
+
+	va_start(args, format);
+	vfprintf(((options->outFileName != NULL) && !strcmp(options->outFileName, "-")) ? stderr : stdout, format, args);
+	va_end(args);
+}
+
+// Error message of a file. The first error is kept for the batch report;
+// in batch mode messages are prefixed with the file name.
+void printError(const struct PlxOptions *options, struct PlxReport *report, const char *format, ...)
+{
+	char message[256];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	if (options->quiet) fprintf(stderr, "%s: Error: %s\n", report->fileName, message);
+	else fprintf(stderr, "Error: %s\n", message);
+
+	if (report->status == 0) {
+		report->status = -1;
+		snprintf(report->error, sizeof(report->error), "%s", message);
+	}
+}
+
+// Convert one plx file as selected by the command line options and fill
+// report with the result
+int convertFile(const char *fileName, const struct PlxOptions *cmdOptions, struct PlxReport *report)
+{
+
+	// Plexon specific structs
+	struct PlxReader			plxReader;
+	struct PL_FileHeader 		plxFileHeader;
+	struct PlxIndex				plxIndex;
+	struct PlxScaleTable		plxScale;
+	struct PlxSummaryVerify		plxVerify;
+	struct PlxStats				plxStats;
+	struct PlxResume			plxResume;
+
+	// Plexon file information variables
+	char 	plxDateTime[25];			// date/time when data was acquired
+
+	// Options (time window and scale table are set per file)
+	struct PlxOptions options = *cmdOptions;
+
+	// output files are named after the input file (or "stdin")
+	const char *baseName = strcmp(fileName, "-") ? fileName : "stdin";
+
+	// misc variables
+	FILE *csvOutFile;					// CSV output file pointer
+	
+	char csvOutFileName[1024];			// CSV output file name
+	char metaFileName[1024];			// meta data file name (binary output)
+	char indexFileName[1024];			// block index file name
+	char summaryFileName[1024];			// summary file name
+	char resumeFileName[1024 + 8];		// checkpoint file name (-resume, <csv output>.resume)
+	FILE *summaryFile;					// summary output file pointer
+	int  csvOutput;						// spikes or events go to the csv output file
+	int  hasIndex = 0;					// block index loaded
+
+	struct timespec tFile;				// start of the conversion
+	struct timespec tStart, tEnd;		// block loop timing
+	double elapsed;						// block loop duration in seconds
+
+	struct PlxCounts counts;			// number of spikes, events and continuous blocks
+	__int64 waveforms;					// spike rows of the csv output, checkpointed runs included
+	struct PlxStats *stats = NULL;		// -stats/-progress counters of this thread
+
+	int result;
+
+	memset(report, 0, sizeof(struct PlxReport));
+	report->fileName = fileName;
+
+	memset(&counts, 0, sizeof(struct PlxCounts));
+	memset(&plxFileHeader, 0, sizeof(struct PL_FileHeader));
+	memset(&plxResume, 0, sizeof(struct PlxResume));
+	memset(plxDateTime, 0, sizeof(plxDateTime));
+
+	clock_gettime(CLOCK_MONOTONIC, &tFile);
+
+	// decoder and writers of this thread report to the bound stats
+	if ((options.stats != PLX_STATS_NONE) || (options.progress > 0)) {
+		stats = &plxStats;
+		plxStatsInit(stats, NULL);
+		stats->json             = (options.stats == PLX_STATS_JSON);
+		stats->fileName         = baseName;
+		stats->progressInterval = options.progress;
+		plxStatsBind(stats);
+	}
+
+	// continuous .ddt files have a format of their own
+	if (plxDdtFileName(fileName)) {
+		plxStatsPhase(stats, PLX_PHASE_FORMAT);
+		convertDdt(fileName, baseName, &options, report);
+		plxStatsPhase(stats, PLX_PHASE_IDLE);
+
+		clock_gettime(CLOCK_MONOTONIC, &tEnd);
+		report->elapsed = (tEnd.tv_sec - tFile.tv_sec) + (tEnd.tv_nsec - tFile.tv_nsec) * 1e-9;
+
+		if (stats != NULL) {
+			stats->bytesIn = report->size;
+			printStats(&options, report, stats, baseName);
+			plxStatsBind(NULL);
+		}
+
+		return report->status;
+	}
+
+	// start (reads file, DSP, event and slow channel headers)
+	plxStatsPhase(stats, PLX_PHASE_HEADERS);
+	result = plxReaderOpen(&plxReader, fileName, options.readerMode);
+
+	report->size = plxReader.size;
+	if (stats != NULL) stats->size = plxReader.size;
+
+	snprintf(indexFileName, sizeof(indexFileName), "%s.plxidx", baseName);
+	
+	if ((result == 0) && options.summary) {
+
+		// inventory from the file header counters, verified against the block headers
+		if (options.verify && (plxSummaryVerify(&plxVerify, &plxReader) != 0)) {
+			printError(&options, report, "Invalid plexon file.");
+		} else {
+			snprintf(summaryFileName, sizeof(summaryFileName), "%s.summary.json", baseName);
+			summaryFile = fopen(summaryFileName, "w");
+			if (summaryFile == NULL) {
+				printError(&options, report, "Cannot open summary file.");
+			} else {
+				plxSummaryWrite(summaryFile, &plxReader, fileName, options.verify ? &plxVerify : NULL);
+				if (fclose(summaryFile) != 0) printError(&options, report, "Cannot write summary file.");
+				else printInfo(&options, " Summary written in file '%s' ...\n", summaryFileName);
+			}
+		}
+
+	} else if ((result == 0) && options.buildIndex) {
+
+		// build block index only
+		if (plxIndexBuild(&plxIndex, &plxReader, PLX_INDEX_SPACING) != 0) {
+			printError(&options, report, "Out of memory.");
+		} else if (plxIndexSave(&plxIndex, indexFileName) != 0) {
+			printError(&options, report, "Cannot write index file.");
+		} else {
+			printInfo(&options, " Index with %lld checkpoints written in file '%s' ...\n", plxIndex.header.numCheckpoints, indexFileName);
+		}
+		plxIndexFree(&plxIndex);
+
+	} else if (result != PLX_ERR_OPEN) {
+
+		// create csv output file from input file name unless -out is given
+		if (options.outFileName != NULL) snprintf(csvOutFileName, sizeof(csvOutFileName), "%s", options.outFileName);
+		else snprintf(csvOutFileName, sizeof(csvOutFileName), "%s.csv", baseName);
+
+		// continuous channels, binary spike columns and split spikes have files of their own
+		csvOutput = options.eventChannel || (!options.slowChannel && !options.trains && !options.features && !options.sample && (options.format == PLX_FORMAT_CSV) && (options.split == PLX_SPLIT_NONE));
+
+		csvOutFile = NULL;
+
+		// time window in ticks
+		if ((result == 0) && options.useFilter) {
+			options.filter.from = (__int64) ceil(options.from * plxReader.fileHeader.ADFrequency);
+			if (options.to >= 0) options.filter.to = (__int64) ceil(options.to * plxReader.fileHeader.ADFrequency);
+		}
+
+		// exit if header doesn't have magic number
+		if (result == PLX_ERR_MEMORY) {
+
+			printError(&options, report, "Out of memory.");
+
+		} else if (result != 0) {
+			
+			printError(&options, report, "Invalid plexon file.");
+
+		} else if (options.resume && (!csvOutput || !strcmp(csvOutFileName, "-") || !strcmp(fileName, "-"))) {
+
+			printError(&options, report, "Option -resume needs an input file and a csv output file.");
+
+		} else if (csvOutput && ((csvOutFile = openCsvOutput(&options, &plxReader, csvOutFileName, &plxResume)) == NULL)) {
+
+			printError(&options, report, "Cannot open csv output file.");
+
+		} else {
+
+			// plexon file header
+			plxFileHeader = plxReader.fileHeader;
+
+			// get date and timestamp from plexon file
+			sprintf(plxDateTime, "%4d-%02d-%02d %02d:%02d:%02d", 
+				plxFileHeader.Year, 
+				plxFileHeader.Month, 
+				plxFileHeader.Day, 
+				plxFileHeader.Hour, 
+				plxFileHeader.Minute, 
+				plxFileHeader.Second);
+
+			printInfo(&options, "\nplx2csv version 0.1.1, Copyright (c) 2011 by Gerold Bausch\n");
+			printInfo(&options, " PLX File Version (%d) from %s\n", plxFileHeader.Version, plxDateTime);
+
+			#ifdef __DEBUG__
+			printInfo(&options, " NumDSPChannels    %d\n", plxFileHeader.NumDSPChannels);
+			printInfo(&options, " NumEventChannels  %d\n", plxFileHeader.NumEventChannels);
+			printInfo(&options, " NumSlowChannels   %d\n\n", plxFileHeader.NumSlowChannels);	
+
+			printInfo(&options, " ADFrequency       %d\n", plxFileHeader.ADFrequency);
+			printInfo(&options, " NumPointsWave     %d\n", plxFileHeader.NumPointsWave);
+			printInfo(&options, " NumPointsPreThr   %d\n", plxFileHeader.NumPointsPreThr);
+			#endif
+
+			if ((options.noHeader != 1) && (csvOutFile != NULL) && (plxResume.runs == 0)) {
+				fprintf(csvOutFile, "# PLX File Version (%d) from %s\n\n", plxFileHeader.Version, plxDateTime);
+				fprintf(csvOutFile, "# ADFrequency=%d\n", plxFileHeader.ADFrequency);
+				fprintf(csvOutFile, "# NumPointsWave=%d\n", plxFileHeader.NumPointsWave);
+				fprintf(csvOutFile, "# NumPointsPreThr=%d\n\n", plxFileHeader.NumPointsPreThr);
+				if (options.eventChannel) fprintf(csvOutFile, "# Time (Seconds); Event; Strobe; Name\n");
+				else fprintf(csvOutFile, "# Time (Seconds); Channel; Unit; Data\n");
+			}
+
+			if (plxResume.runs > 0) {
+				printInfo(&options, " Resuming at offset %llu after %lld spikes, %lld events ...\n", plxResume.offset, plxResume.spikes, plxResume.events);
+			}
 
-					// get data from plexon file
-					while ((feof(plexonInFile) == 0) && 
-						(fread(&plxDataBlockHeader, sizeof(struct PL_DataBlockHeader), 1, plexonInFile)) == 1) {
-
-						// extract timestamp
-						timestamp = (((__int64)(plxDataBlockHeader.UpperByteOf5ByteTimestamp))<<32) + 
-						 		(__int64)(plxDataBlockHeader.TimeStamp);
-						
-						// calculate timestamp in seconds
-						seconds = (double) timestamp / (double) plxFileHeader.ADFrequency;
-
-						// extract spike channel data
-						if ((plxDataBlockHeader.Type == 1) || (option_SpikeChannel == 1)) {
-							
-							fprintf(csvOutFile, "%.6f,", seconds);
-							fprintf(csvOutFile, "%d,", plxDataBlockHeader.Channel);
-							fprintf(csvOutFile, "%d,", plxDataBlockHeader.Unit);
-
-							// if block header contains waveforms
-							if (plxDataBlockHeader.NumberOfWaveforms == 1) {
-								
-								// allocate memory and read waveforms
-								pWaveformData = (short*) calloc (plxDataBlockHeader.NumberOfWordsInWaveform, sizeof(short));
-								fread(&pWaveformData[0], sizeof(short) * plxDataBlockHeader.NumberOfWordsInWaveform, 1, plexonInFile);
-
-								// write waveforms in csv file
-								for (i = 0; i < (plxDataBlockHeader.NumberOfWordsInWaveform - 1); i++) {
-									fprintf(csvOutFile, "%d,", pWaveformData[i]);
-								}
-								fprintf(csvOutFile, "%d\n", pWaveformData[plxDataBlockHeader.NumberOfWordsInWaveform-1]);
-							}
-							// count number of spike events
-							cntSpikes++;
-
-						// extract event channel data if selected
-						} else if ((plxDataBlockHeader.Type == 4) || (option_EventChannel == 1)) {
-							
-							// TODO: save event channel information
-							cntEvents++;
-
-						// extract slow channel data if selected
-						} else if ((plxDataBlockHeader.Type == 5) || (option_SlowChannel == 1)) {
-
-							// TODO: save slow channel information
-							cntSlow++;
-						}
-						
+			// use (or create) the block index to seek straight to the selected blocks
+			if (options.useFilter && (plxReader.mode == PLX_READER_MMAP) && !options.resume) {
+				if (plxIndexLoad(&plxIndex, indexFileName, &plxReader) == 0) {
+					hasIndex = 1;
+				} else if (plxIndexBuild(&plxIndex, &plxReader, PLX_INDEX_SPACING) == 0) {
+					hasIndex = 1;
+					if (plxIndexSave(&plxIndex, indexFileName) == 0) {
+						printInfo(&options, " Index written in file '%s' ...\n", indexFileName);
 					}
-					// print some info on cmd line
-					if (cntSpikes > 0) fprintf(stdout, " Found %d spikes ...\n", cntSpikes);
-					if (cntEvents > 0) fprintf(stdout, " Found %d events ...\n", cntEvents);
-					if (cntSlow > 0) fprintf(stdout, " Found %d continuous ...\n", cntSlow);
+				}
+			}
+
+			// raw ADC values to microvolts per channel
+			if (options.scaleMicrovolts) {
+				if (plxScaleTableInit(&plxScale, &plxReader) == 0) options.scale = &plxScale;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+			// decoding and writing switch phases on their own
+			plxStatsPhase(stats, PLX_PHASE_FORMAT);
+
+			// get data from plexon file
+			if (options.scaleMicrovolts && (options.scale == NULL)) {
+
+				// the file is not converted in raw ADC values instead
+				printError(&options, report, "Out of memory.");
+
+			} else if (options.eventChannel) {
+
+				// events only, spike and continuous blocks are skipped
+				if (convertEvents(&plxReader, &options, hasIndex ? &plxIndex : NULL, csvOutFile, &counts) != 0) {
+					printError(&options, report, "Cannot write csv output file.");
+				}
+
+			} else if (options.slowChannel) {
+
+				// continuous channels go to one file per channel
+				if (options.threads > 1) printInfo(&options, " Continuous channels are written on one thread ...\n");
+
+				result = convertSlow(&plxReader, &options, hasIndex ? &plxIndex : NULL, baseName, &counts);
+				if (result == PLX_ERR_MEMORY) printError(&options, report, "Out of memory.");
+				else if (result != 0) printError(&options, report, "Cannot write continuous channel files.");
+
+			} else if (options.trains) {
+
+				// spike timestamps only, the waveforms are never read
+				if (options.threads > 1) printInfo(&options, " Spike trains are collected on one thread ...\n");
+
+				snprintf(metaFileName, sizeof(metaFileName), "%s.meta.csv", baseName);
+				if (plxNpyWriteMeta(&plxReader, metaFileName) != 0) printError(&options, report, "Cannot write meta data file.");
+
+				result = convertTrains(&plxReader, &options, hasIndex ? &plxIndex : NULL, baseName, &counts);
+				if (result == PLX_ERR_MEMORY) printError(&options, report, "Out of memory.");
+				else if (result != 0) printError(&options, report, "Cannot write spike train files.");
+
+			} else if (options.features) {
+
+				// waveform features instead of the waveforms
+				if (options.threads > 1) printInfo(&options, " Spike features are computed on one thread ...\n");
+
+				snprintf(metaFileName, sizeof(metaFileName), "%s.meta.csv", baseName);
+				if (plxNpyWriteMeta(&plxReader, metaFileName) != 0) printError(&options, report, "Cannot write meta data file.");
+
+				result = convertFeatures(&plxReader, &options, hasIndex ? &plxIndex : NULL, baseName, &counts);
+				if (result == PLX_ERR_MEMORY) printError(&options, report, "Out of memory.");
+				else if (result != 0) printError(&options, report, "Cannot write spike feature files.");
+
+			} else if (options.sample > 0) {
+
+				// waveforms of a random subset of the spikes of every unit
+				if (options.threads > 1) printInfo(&options, " Spikes are sampled on one thread ...\n");
+
+				result = convertSample(&plxReader, &options, hasIndex ? &plxIndex : NULL, baseName, &counts);
+				if (result == PLX_ERR_MEMORY) printError(&options, report, "Out of memory.");
+				else if (result != 0) printError(&options, report, "Cannot write sample csv file.");
+
+			} else if (options.split != PLX_SPLIT_NONE) {
+
+				// one csv file per channel (and unit)
+				if (options.threads > 1) printInfo(&options, " Split files are written on one thread ...\n");
+
+				if (convertSplit(&plxReader, &options, hasIndex ? &plxIndex : NULL, baseName, &counts) != 0) {
+					printError(&options, report, "Cannot write split csv files.");
+				}
 
-					fprintf(stdout, " CSV data written in file '%s' ...\n", csvOutFileName);
+			} else if (options.format == PLX_FORMAT_BIN) {
 
-					// free allocated memory
-					free(pWaveformData);
+				// spike columns as .npy files
+				if (options.threads > 1) printInfo(&options, " Binary columns are written on one thread ...\n");
+
+				snprintf(metaFileName, sizeof(metaFileName), "%s.meta.csv", baseName);
+				if (plxNpyWriteMeta(&plxReader, metaFileName) != 0) printError(&options, report, "Cannot write meta data file.");
+
+				if (convertNpy(&plxReader, &options, hasIndex ? &plxIndex : NULL, baseName, &counts) != 0) {
+					printError(&options, report, "Cannot write binary column files.");
+				}
+
+			} else if ((options.threads > 1) && (plxReader.mode == PLX_READER_MMAP) && !hasIndex) {
+
+				// format chunks of blocks on several threads
+				if (convertCsvParallel(&plxReader, &options, csvOutFile, &counts) != 0) {
+					printError(&options, report, "Cannot write csv output file.");
 				}
 
 			} else {
-				fprintf(stderr, "Error: Cannot open csv output file.\n");
+
+				if ((options.threads > 1) && !hasIndex) printInfo(&options, " Multi-threading needs a mapped input file, converting on one thread ...\n");
+
+				// decode, format and write on overlapping stages
+				if (convertCsvPipeline(&plxReader, &options, hasIndex ? &plxIndex : NULL, csvOutFile, &counts) != 0) {
+					printError(&options, report, "Cannot write csv output file.");
+				}
 			}
+
+			plxStatsPhase(stats, PLX_PHASE_IDLE);
+
+			clock_gettime(CLOCK_MONOTONIC, &tEnd);
+			elapsed = (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) * 1e-9;
+
+			if (hasIndex) plxIndexFree(&plxIndex);
+			if (options.scale != NULL) plxScaleTableFree(&plxScale);
+
+			// print some info on cmd line
+			if (counts.spikes > 0) printInfo(&options, " Found %d spikes ...\n", counts.spikes);
+			if (counts.events > 0) printInfo(&options, " Found %d events ...\n", counts.events);
+			if (counts.slow > 0) printInfo(&options, " Found %d continuous ...\n", counts.slow);
+
+			if (plxReader.truncated && options.resume) printInfo(&options, " Incomplete data block at end of file is left for the next run ...\n");
+			else if (plxReader.truncated) printInfo(&options, " Skipped incomplete data block at end of file ...\n");
+			report->truncated = plxReader.truncated;
+
+			printInfo(&options, " Read %.1f MB in %.3f s (%.1f MB/s, %s) ...\n",
+				counts.bytes / 1e6, elapsed,
+				(elapsed > 0) ? counts.bytes / 1e6 / elapsed : 0.0,
+				(plxReader.mode == PLX_READER_MMAP) ? "mmap" : "fread");
+
+			if (options.slowChannel) printInfo(&options, " Continuous data written in files '%s.slow*' ...\n", baseName);
+			else if (options.split != PLX_SPLIT_NONE) printInfo(&options, " CSV data written in files '%s.ch*.csv' ...\n", baseName);
+			else if (options.trains) printInfo(&options, " Spike trains written in files '%s.trains*.npy' ...\n", baseName);
+			else if ((options.sample > 0) && (options.outFileName != NULL)) printInfo(&options, " Sampled waveforms written in file '%s' ...\n", options.outFileName);
+			else if (options.sample > 0) printInfo(&options, " Sampled waveforms written in file '%s.sample.csv' ...\n", baseName);
+			else if (options.features) printInfo(&options, " Spike features written in files '%s.features*.npy' ...\n", baseName);
+			else if (!csvOutput) printInfo(&options, " Binary data written in files '%s.*.npy' ...\n", baseName);
+			else if (csvOutFile == stdout) printInfo(&options, " CSV data written to stdout ...\n");
+			else printInfo(&options, " CSV data written in file '%s' ...\n", csvOutFileName);
 			
-			// close csv output file
-			fclose(csvOutFile);
+			waveforms = plxResume.spikes + counts.spikes;
+
+			// checkpoint behind the last complete block for the next run
+			if (options.resume && (csvOutFile != NULL) && (report->status == 0)) {
+				if (fflush(csvOutFile) != 0) {
+					printError(&options, report, "Cannot write csv output file.");
+				} else {
+					plxResume.offset     = plxReader.offset;
+					plxResume.outputSize = (unsigned __int64) ftello(csvOutFile);
+					plxResume.spikes    += counts.spikes;
+					plxResume.events    += counts.events;
+					plxResume.slow      += counts.slow;
+					plxResume.runs++;
+
+					snprintf(resumeFileName, sizeof(resumeFileName), "%s.resume", csvOutFileName);
+					if (plxResumeSave(&plxResume, resumeFileName) != 0) printError(&options, report, "Cannot write checkpoint file.");
+				}
+			}
+
+			// close csv output file (stdout is flushed only)
+			if (csvOutFile == stdout) {
+				if ((fflush(stdout) != 0) || ferror(stdout)) printError(&options, report, "Cannot write csv output file.");
+			} else if ((csvOutFile != NULL) && (fclose(csvOutFile) != 0)) {
+				printError(&options, report, "Cannot write csv output file.");
+			}
 
 			// print separate header file
-			if (option_HeaderFile == 1) {
+			if (options.headerFile == 1) {
 
-				sprintf(csvOutFileName, "%s.header.csv", argv[1]);
+				snprintf(csvOutFileName, sizeof(csvOutFileName), "%s.header.csv", baseName);
 				csvOutFile = fopen(csvOutFileName, "w+");
 
-				fprintf(csvOutFile, "Timestamp,%s\n", plxDateTime);
-				fprintf(csvOutFile, "NumDSPChannels,%d\n", plxFileHeader.NumDSPChannels);
-				fprintf(csvOutFile, "NumEventChannels,%d\n", plxFileHeader.NumEventChannels);
-				fprintf(csvOutFile, "NumSlowChannels,%d\n", plxFileHeader.NumSlowChannels);	
-				fprintf(csvOutFile, "ADFrequency,%d\n", plxFileHeader.ADFrequency);
-				fprintf(csvOutFile, "NumPointsWave,%d\n", plxFileHeader.NumPointsWave);
-				fprintf(csvOutFile, "NumPointsPreThr,%d\n", plxFileHeader.NumPointsPreThr);
-				fprintf(csvOutFile, "Waveforms,%d\n", cntSpikes);
-
-				fclose(csvOutFile);
+				if (csvOutFile != NULL) {
+					fprintf(csvOutFile, "Timestamp,%s\n", plxDateTime);
+					fprintf(csvOutFile, "NumDSPChannels,%d\n", plxFileHeader.NumDSPChannels);
+					fprintf(csvOutFile, "NumEventChannels,%d\n", plxFileHeader.NumEventChannels);
+					fprintf(csvOutFile, "NumSlowChannels,%d\n", plxFileHeader.NumSlowChannels);	
+					fprintf(csvOutFile, "ADFrequency,%d\n", plxFileHeader.ADFrequency);
+					fprintf(csvOutFile, "NumPointsWave,%d\n", plxFileHeader.NumPointsWave);
+					fprintf(csvOutFile, "NumPointsPreThr,%d\n", plxFileHeader.NumPointsPreThr);
+					fprintf(csvOutFile, "Waveforms,%lld\n", waveforms);
+					fclose(csvOutFile);
+				} else {
+					printError(&options, report, "Cannot open header file.");
+				}
 			}
-
-			fprintf(stdout, " Done!\n\n");
-			
-		} else {
-			fprintf(stderr, "Error: Cannot open input file.\n");
 		}
 
-		fclose(plexonInFile);
+		printInfo(&options, " Done!\n\n");
+		
+	} else {
+		printError(&options, report, "Cannot open input file.");
 	}
 
-	return 0;
+	plxReaderClose(&plxReader);
+	plxStatsPhase(stats, PLX_PHASE_IDLE);
+
+	clock_gettime(CLOCK_MONOTONIC, &tEnd);
+	report->counts  = counts;
+	report->elapsed = (tEnd.tv_sec - tFile.tv_sec) + (tEnd.tv_nsec - tFile.tv_nsec) * 1e-9;
+
+	if (stats != NULL) {
+		stats->bytesIn = counts.bytes;
+		printStats(&options, report, stats, baseName);
+		plxStatsBind(NULL);
+	}
+
+	return report->status;
+}
+
+// Open the csv output file or stdout. With -resume an earlier output is
+// continued from its checkpoint: the reader is moved behind the blocks
+// converted before and rows of an interrupted run are cut off. resume gets
+// the checkpoint to update (runs is 0 for a new output).
+FILE *openCsvOutput(const struct PlxOptions *options, struct PlxReader *reader, const char *csvOutFileName, struct PlxResume *resume)
+{
+	const struct PlxFilter *filter = &options->filter;
+	char resumeFileName[1024];
+	struct stat st;
+	unsigned int stamp;
+
+	if (!strcmp(csvOutFileName, "-")) return stdout;
+	if (!options->resume) return fopen(csvOutFileName, "w+");
+
+	// options that change the rows
+	stamp = plxResumeHash(2166136261u, &options->eventChannel, sizeof(char));
+	stamp = plxResumeHash(stamp, &options->scaleMicrovolts, sizeof(char));
+	stamp = plxResumeHash(stamp, &options->noHeader, sizeof(char));
+	stamp = plxResumeHash(stamp, &filter->types, sizeof(unsigned int));
+	stamp = plxResumeHash(stamp, &filter->from, sizeof(__int64));
+	stamp = plxResumeHash(stamp, &filter->to, sizeof(__int64));
+	stamp = plxResumeHash(stamp, &filter->allChannels, sizeof(int));
+	stamp = plxResumeHash(stamp, filter->channels, sizeof(filter->channels));
+	stamp = plxResumeHash(stamp, &filter->allUnits, sizeof(int));
+	stamp = plxResumeHash(stamp, filter->units, sizeof(filter->units));
+
+	snprintf(resumeFileName, sizeof(resumeFileName), "%s.resume", csvOutFileName);
+
+	// the output must still hold every row of the checkpoint (truncate would pad it)
+	if ((plxResumeLoad(resume, resumeFileName, reader, stamp) == 0) &&
+		(stat(csvOutFileName, &st) == 0) && ((unsigned __int64) st.st_size >= resume->outputSize) &&
+		(truncate(csvOutFileName, (off_t) resume->outputSize) == 0) &&
+		(plxReaderSeek(reader, resume->offset) == 0)) {
+		return fopen(csvOutFileName, "a");
+	}
+
+	// no (matching) checkpoint, start over
+	plxResumeInit(resume, reader, stamp);
+	return fopen(csvOutFileName, "w+");
+}
+
+// Set by SIGINT/SIGTERM to end -follow after the current run
+static volatile sig_atomic_t followStop = 0;
+
+static void followSignal(int signum)
+{
+	(void) signum;
+	followStop = 1;
+}
+
+// Convert the blocks added to a growing file every options->follow
+// seconds until SIGINT or SIGTERM. Every run resumes from the checkpoint
+// of the previous one, so its cost depends on the new blocks only.
+int followFile(const char *fileName, const struct PlxOptions *options, struct PlxReport *report)
+{
+	struct PlxOptions runOptions = *options;
+	struct timespec pause = { 0, 100000000 };
+	double waited;
+	int result, runs = 0;
+
+	signal(SIGINT, followSignal);
+	signal(SIGTERM, followSignal);
+
+	for (;;) {
+
+		result = convertFile(fileName, &runOptions, report);
+		if (result != 0) break;
+
+		// full messages for the first run, one line per run with new rows after it
+		if (runs++ == 0) {
+			runOptions.quiet = 1;
+		} else if ((report->counts.spikes > 0) || (report->counts.events > 0)) {
+			printInfo(options, " %s: %d new spikes, %d new events ...\n", fileName, report->counts.spikes, report->counts.events);
+		}
+
+		for (waited = 0; !followStop && (waited < options->follow); waited += 0.1) nanosleep(&pause, NULL);
+		if (followStop) break;
+	}
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	return result;
+}
+
+// Merge the spike (or event) blocks of several plx files into one csv file
+// ordered by timestamp (see plxmerge.h). The files must share the clock,
+// i.e. have the same ADFrequency. With -renumber the spike channels of every
+// file are moved by an offset to keep channels of different rigs apart.
+int mergeFiles(const char **fileNames, int numFiles, const struct PlxOptions *cmdOptions, struct PlxReport *report)
+{
+	struct PlxMerge merge;
+	struct PlxBatch batch;
+	struct PlxOutBuf csvOut;
+	struct PlxEventTable *tables = NULL;
+	struct PlxOptions options = *cmdOptions;
+	struct PlxCounts counts;
+	const struct PL_FileHeader *fileHeader;
+	struct timespec tStart, tEnd;
+	FILE *csvOutFile = NULL;
+	char csvOutFileName[1024];
+	int i, j, frequency, result;
+
+	memset(report, 0, sizeof(struct PlxReport));
+	memset(&counts, 0, sizeof(struct PlxCounts));
+	memset(&csvOut, 0, sizeof(struct PlxOutBuf));
+	memset(&batch, 0, sizeof(struct PlxBatch));
+	report->fileName = fileNames[0];
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	if (options.slowChannel || options.trains || options.features || (options.sample > 0) || options.resume ||
+		options.scaleMicrovolts || (options.format != PLX_FORMAT_CSV) || (options.split != PLX_SPLIT_NONE)) {
+		printError(&options, report, "Option -merge writes spike or event rows in raw ADC values into one csv file only.");
+		return report->status;
+	}
+
+	// csv rows of the merge go to <first input>.merged.csv unless -out is given
+	if (options.outFileName != NULL) snprintf(csvOutFileName, sizeof(csvOutFileName), "%s", options.outFileName);
+	else snprintf(csvOutFileName, sizeof(csvOutFileName), "%s.merged.csv", strcmp(fileNames[0], "-") ? fileNames[0] : "stdin");
+
+	result = plxMergeOpen(&merge, fileNames, numFiles, options.readerMode);
+
+	if (result == PLX_ERR_MEMORY) {
+		printError(&options, report, "Out of memory.");
+		plxMergeClose(&merge);
+		return report->status;
+	} else if (result != 0) {
+		printError(&options, report, (result == PLX_ERR_OPEN) ? "Cannot open input file '%s'." : "Invalid plexon file '%s'.", fileNames[merge.failed]);
+		plxMergeClose(&merge);
+		return report->status;
+	}
+
+	// one clock for all timestamps
+	fileHeader = &merge.sources[0].reader.fileHeader;
+	frequency  = fileHeader->ADFrequency;
+
+	for (i = 1; i < numFiles; i++) {
+		if (merge.sources[i].reader.fileHeader.ADFrequency != frequency) {
+			printError(&options, report, "File '%s' has a different ADFrequency, cannot merge timestamps.", fileNames[i]);
+			plxMergeClose(&merge);
+			return report->status;
+		}
+	}
+
+	if ((options.renumber != NULL) && (plxMergeRenumber(&merge, options.renumber) != 0)) {
+		printError(&options, report, "Invalid channel offsets '%s'.", options.renumber);
+		plxMergeClose(&merge);
+		return report->status;
+	}
+
+	// time window in ticks
+	if (options.useFilter) {
+		options.filter.from = (__int64) ceil(options.from * frequency);
+		if (options.to >= 0) options.filter.to = (__int64) ceil(options.to * frequency);
+	}
+	options.filter.types = options.eventChannel ? PLX_TYPE_BIT(4) : PLX_TYPE_BIT(1);
+
+	// event names of every input
+	if (options.eventChannel) {
+		tables = (struct PlxEventTable*) calloc (numFiles, sizeof(struct PlxEventTable));
+		for (i = 0; (tables != NULL) && (i < numFiles); i++) {
+			if (plxEventTableInit(&tables[i], &merge.sources[i].reader) != 0) result = PLX_ERR_MEMORY;
+		}
+		if (tables == NULL) result = PLX_ERR_MEMORY;
+	}
+
+	if ((result != 0) || (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * fileHeader->NumPointsWave) != 0) ||
+		(plxMergeStart(&merge, &options.filter, PLX_BATCH_BLOCKS) != 0)) {
+
+		printError(&options, report, "Out of memory.");
+
+	} else if ((csvOutFile = strcmp(csvOutFileName, "-") ? fopen(csvOutFileName, "w+") : stdout) == NULL) {
+
+		printError(&options, report, "Cannot open csv output file.");
+
+	} else if (plxOutBufInit(&csvOut, csvOutFile, PLX_OUTBUF_SIZE) != 0) {
+
+		printError(&options, report, "Out of memory.");
+
+	} else {
+
+		printInfo(&options, "\nplx2csv version 0.1.1, Copyright (c) 2011 by Gerold Bausch\n");
+		printInfo(&options, " Merging %d files ...\n", numFiles);
+
+		if (options.noHeader != 1) {
+			fprintf(csvOutFile, "# PLX File Version (%d), %d merged files\n\n", fileHeader->Version, numFiles);
+			for (i = 0; i < numFiles; i++) fprintf(csvOutFile, "# Source %d=%s (channel offset %d)\n", i + 1, fileNames[i], merge.sources[i].channelOffset);
+			fprintf(csvOutFile, "\n# ADFrequency=%d\n", frequency);
+			fprintf(csvOutFile, "# NumPointsWave=%d\n", fileHeader->NumPointsWave);
+			fprintf(csvOutFile, "# NumPointsPreThr=%d\n\n", fileHeader->NumPointsPreThr);
+			if (options.eventChannel) fprintf(csvOutFile, "# Time (Seconds); Event; Strobe; Name\n");
+			else fprintf(csvOutFile, "# Time (Seconds); Channel; Unit; Data\n");
+		}
+
+		while (!csvOut.error && plxMergeNext(&merge, &batch)) {
+			if (options.eventChannel) {
+				for (j = 0; j < batch.count; j++) plxFormatEventRow(&csvOut, &batch, j, frequency, &tables[merge.source[j]]);
+				counts.events += batch.count;
+			} else {
+				formatCsvBatch(&options, &batch, frequency, &csvOut, &counts);
+			}
+		}
+
+		plxOutBufFree(&csvOut);
+		if (csvOut.error) printError(&options, report, "Cannot write csv output file.");
+
+		counts.bytes = plxMergeBytes(&merge);
+
+		clock_gettime(CLOCK_MONOTONIC, &tEnd);
+		report->elapsed = (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) * 1e-9;
+
+		if (counts.spikes > 0) printInfo(&options, " Found %d spikes ...\n", counts.spikes);
+		if (counts.events > 0) printInfo(&options, " Found %d events ...\n", counts.events);
+
+		printInfo(&options, " Read %.1f MB in %.3f s (%.1f MB/s) ...\n",
+			counts.bytes / 1e6, report->elapsed, (report->elapsed > 0) ? counts.bytes / 1e6 / report->elapsed : 0.0);
+
+		if (csvOutFile == stdout) printInfo(&options, " CSV data written to stdout ...\n");
+		else printInfo(&options, " CSV data written in file '%s' ...\n", csvOutFileName);
+		printInfo(&options, " Done!\n\n");
+	}
+
+	// close csv output file (stdout is flushed only)
+	if (csvOutFile == stdout) {
+		if ((fflush(stdout) != 0) || ferror(stdout)) printError(&options, report, "Cannot write csv output file.");
+	} else if ((csvOutFile != NULL) && (fclose(csvOutFile) != 0)) {
+		printError(&options, report, "Cannot write csv output file.");
+	}
+
+	if (tables != NULL) {
+		for (i = 0; i < numFiles; i++) plxEventTableFree(&tables[i]);
+		free(tables);
+	}
+
+	plxBatchFree(&batch);
+	plxMergeClose(&merge);
+
+	report->counts = counts;
+
+	return report->status;
+}
+
+// Report the -stats of a file: a table on the command line (stderr in
+// batch mode, whole reports at a time) or <input>.stats.json
+void printStats(const struct PlxOptions *options, struct PlxReport *report, const struct PlxStats *stats, const char *baseName)
+{
+	char statsFileName[1024];
+	FILE *statsFile;
+
+	if (options->stats == PLX_STATS_JSON) {
+
+		snprintf(statsFileName, sizeof(statsFileName), "%s.stats.json", baseName);
+		statsFile = fopen(statsFileName, "w");
+		if (statsFile == NULL) {
+			printError(options, report, "Cannot open stats file.");
+		} else {
+			plxStatsWrite(statsFile, stats, report->elapsed);
+			if (fclose(statsFile) != 0) printError(options, report, "Cannot write stats file.");
+			else printInfo(options, " Stats written in file '%s' ...\n", statsFileName);
+		}
+
+	} else if (options->stats == PLX_STATS_TEXT) {
+
+		statsFile = (options->quiet || ((options->outFileName != NULL) && !strcmp(options->outFileName, "-"))) ? stderr : stdout;
+
+		flockfile(statsFile);
+		if (options->quiet) fprintf(statsFile, "%s:\n", report->fileName);
+		plxStatsWrite(statsFile, stats, report->elapsed);
+		funlockfile(statsFile);
+	}
+}
+
+// Write the channels of a .ddt file into one file per channel (csv, or
+// raw int16 with -format bin / -slowbin)
+int convertDdt(const char *fileName, const char *baseName, const struct PlxOptions *options, struct PlxReport *report)
+{
+	struct PlxDdtReader ddtReader;
+	struct PlxDdtWriter ddtWriter;
+	const short *frames;
+	struct timespec tStart, tEnd;
+	double elapsed;
+	int numFrames, result;
+
+	result = plxDdtOpen(&ddtReader, fileName);
+	report->size = ddtReader.size;
+
+	if (result == PLX_ERR_OPEN) {
+
+		printError(options, report, "Cannot open input file.");
+
+	} else if (result != 0) {
+
+		printError(options, report, "Invalid ddt file.");
+
+	} else if (plxDdtWriterOpen(&ddtWriter, &ddtReader, &options->filter, baseName, options->slowFormat) != 0) {
+
+		printError(options, report, "Cannot open ddt channel files.");
+
+	} else {
+
+		printInfo(options, "\nplx2csv version 0.1.1, Copyright (c) 2011 by Gerold Bausch\n");
+		printInfo(options, " DDT File Version (%d) from %4d-%02d-%02d %02d:%02d:%02d\n", ddtReader.header.Version,
+			ddtReader.header.Year, ddtReader.header.Month, ddtReader.header.Day,
+			ddtReader.header.Hour, ddtReader.header.Minute, ddtReader.header.Second);
+		printInfo(options, " %d of %d channels at %g Hz ...\n", ddtWriter.numChannels, ddtReader.frameWidth, ddtReader.header.Freq);
+
+		clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+		// frames are de-interleaved in place from the mapping
+		while (!ddtWriter.error && ((numFrames = plxDdtNext(&ddtReader, &frames, PLX_DDT_FRAMES)) > 0)) {
+			plxDdtWriterFrames(&ddtWriter, frames, numFrames);
+		}
+
+		if (plxDdtWriterClose(&ddtWriter) != 0) printError(options, report, "Cannot write ddt channel files.");
+
+		clock_gettime(CLOCK_MONOTONIC, &tEnd);
+		elapsed = (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) * 1e-9;
+
+		report->counts.bytes = ddtReader.header.DataOffset + (unsigned __int64) ddtReader.frame * ddtReader.frameWidth * sizeof(short);
+		report->truncated    = ddtReader.truncated;
+
+		printInfo(options, " Found %lld frames ...\n", ddtReader.frame);
+		if (ddtReader.truncated) printInfo(options, " Skipped incomplete frame at end of file ...\n");
+		printInfo(options, " Read %.1f MB in %.3f s (%.1f MB/s, mmap) ...\n", report->counts.bytes / 1e6, elapsed,
+			(elapsed > 0) ? report->counts.bytes / 1e6 / elapsed : 0.0);
+		printInfo(options, " Continuous data written in files '%s.ddt*' ...\n", baseName);
+		printInfo(options, " Done!\n\n");
+	}
+
+	plxDdtClose(&ddtReader);
+
+	return report->status;
+}
+
+// Convert data blocks on the calling thread. With an index only the
+// segments that can contain blocks accepted by options->filter are read.
+int convertCsvSerial(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, FILE *csvOutFile, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxOutBuf csvOut;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+	int result = 0;
+
+	// get data from plexon file in batches
+	if ((plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * reader->fileHeader.NumPointsWave) != 0) ||
+		(plxOutBufInit(&csvOut, csvOutFile, PLX_OUTBUF_SIZE) != 0)) {
+		plxBatchFree(&batch);
+		return PLX_ERR_MEMORY;
+	}
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (plxIndexNextRange(index, &options->filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &options->filter;
+
+			while (plxDecoderNext(&decoder, &batch)) {
+				formatCsvBatch(options, &batch, reader->fileHeader.ADFrequency, &csvOut, counts);
+			}
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter = &options->filter;
+
+		// rows are formatted into a large buffer and written in big chunks
+		while (plxDecoderNext(&decoder, &batch)) {
+			formatCsvBatch(options, &batch, reader->fileHeader.ADFrequency, &csvOut, counts);
+		}
+
+		counts->bytes = reader->offset;
+	}
+
+	plxOutBufFree(&csvOut);
+	if (csvOut.error) result = -1;
+
+	// free batch buffers
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Write event blocks as CSV rows. Other block types are rejected by the
+// filter before their waveforms are copied into a batch.
+int convertEvents(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, FILE *csvOutFile, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxOutBuf csvOut;
+	struct PlxEventTable table;
+	struct PlxFilter filter;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+	int j, result = 0;
+
+	memset(&csvOut, 0, sizeof(struct PlxOutBuf));
+	memset(&table, 0, sizeof(struct PlxEventTable));
+
+	// event blocks have no samples
+	if ((plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, 0) != 0) ||
+		(plxOutBufInit(&csvOut, csvOutFile, PLX_OUTBUF_SIZE) != 0) ||
+		(plxEventTableInit(&table, reader) != 0)) {
+		plxEventTableFree(&table);
+		plxOutBufFree(&csvOut);
+		plxBatchFree(&batch);
+		return PLX_ERR_MEMORY;
+	}
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(4);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (plxIndexNextRange(index, &filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &filter;
+
+			while (plxDecoderNext(&decoder, &batch)) {
+				for (j = 0; j < batch.count; j++) plxFormatEventRow(&csvOut, &batch, j, reader->fileHeader.ADFrequency, &table);
+				counts->events += batch.count;
+			}
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter = &filter;
+
+		while (plxDecoderNext(&decoder, &batch)) {
+			for (j = 0; j < batch.count; j++) plxFormatEventRow(&csvOut, &batch, j, reader->fileHeader.ADFrequency, &table);
+			counts->events += batch.count;
+		}
+
+		counts->bytes = reader->offset;
+	}
+
+	plxOutBufFree(&csvOut);
+	if (csvOut.error) result = -1;
+
+	plxEventTableFree(&table);
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Collect the spike timestamps per channel and unit from the block headers
+// (the waveforms are skipped) and write them as .npy arrays, with -bin also
+// the spike counts per time bin
+int convertTrains(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxTrains trains;
+	struct PlxFilter filter;
+	unsigned __int64 start, end;
+	__int64 position = 0, binTicks, origin, last, numBins;
+	char metaFileName[1024];
+	FILE *metaFile;
+	int result = 0;
+
+	// spike blocks carry no samples here
+	if (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, 0) != 0) return PLX_ERR_MEMORY;
+
+	plxTrainsInit(&trains, reader);
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(1);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (!trains.error && plxIndexNextRange(index, &filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter      = &filter;
+			decoder.headersOnly = 1;
+
+			while (!trains.error && plxDecoderNext(&decoder, &batch)) plxTrainsBatch(&trains, &batch);
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter      = &filter;
+		decoder.headersOnly = 1;
+
+		while (!trains.error && plxDecoderNext(&decoder, &batch)) plxTrainsBatch(&trains, &batch);
+
+		counts->bytes = reader->offset;
+	}
+
+	counts->spikes = (int) trains.spikes;
+
+	if (trains.error) {
+		result = PLX_ERR_MEMORY;
+	} else {
+		plxTrainsFinish(&trains);
+		if (plxTrainsWrite(&trains, baseName) != 0) result = -1;
+	}
+
+	// bins from the start of the time window up to its end or the last spike
+	if ((result == 0) && (options->binWidth > 0)) {
+
+		binTicks = (__int64)(options->binWidth * reader->fileHeader.ADFrequency + 0.5);
+		if (binTicks < 1) binTicks = 1;
+
+		origin = filter.from;
+		last   = (filter.to != 0x7FFFFFFFFFFFFFFFLL) ? filter.to - 1 : trains.lastTimestamp;
+		numBins = (last >= origin) ? (last - origin) / binTicks + 1 : 0;
+
+		result = plxTrainsWriteCounts(&trains, baseName, origin, binTicks, numBins);
+
+		// bin layout next to the file header values
+		snprintf(metaFileName, sizeof(metaFileName), "%s.meta.csv", baseName);
+		metaFile = fopen(metaFileName, "a");
+		if (metaFile != NULL) {
+			fprintf(metaFile, "BinTicks,%lld\n", binTicks);
+			fprintf(metaFile, "BinOrigin,%lld\n", origin);
+			fprintf(metaFile, "NumBins,%lld\n", numBins);
+			if (fclose(metaFile) != 0) result = -1;
+		} else {
+			result = -1;
+		}
+
+		if (result == 0) printInfo(options, " Counted spikes in %lld bins of %lld ticks ...\n", numBins, binTicks);
+	}
+
+	plxTrainsFree(&trains);
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Format the spike blocks of a batch into the split output of their channel
+// (and unit)
+static void formatSplitBatch(const struct PlxOptions *options, const struct PlxBatch *batch, int frequency, struct PlxSplitWriter *writer, struct PlxCounts *counts)
+{
+	struct PlxOutBuf *out;
+	int j, words;
+
+	for (j = 0; j < batch->count; j++) {
+
+		// longest row, see plxFormatCsvRow() and plxFormatCsvRowScaled()
+		words = (batch->numWords[j] > 0) ? batch->numWords[j] : 0;
+		out = plxSplitReserve(writer, batch->channel[j], batch->unit[j], 352 + 48 * (size_t) words);
+		if (out == NULL) return;
+
+		if (options->scale != NULL) plxFormatCsvRowScaled(out, batch, j, frequency, options->scale);
+		else plxFormatCsvRow(out, batch, j, frequency);
+
+		counts->spikes++;
+	}
+}
+
+// Write spike blocks to one csv file per channel or per channel and unit
+int convertSplit(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxSplitWriter writer;
+	struct PlxFilter filter;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+	int frequency = reader->fileHeader.ADFrequency;
+	int result;
+
+	if (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * reader->fileHeader.NumPointsWave) != 0) return PLX_ERR_MEMORY;
+
+	if (plxSplitOpen(&writer, baseName, options->split, options->noHeader ? NULL : "# Time (Seconds); Channel; Unit; Data\n") != 0) {
+		plxBatchFree(&batch);
+		return PLX_ERR_MEMORY;
+	}
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(1);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (plxIndexNextRange(index, &filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &filter;
+
+			while (plxDecoderNext(&decoder, &batch)) formatSplitBatch(options, &batch, frequency, &writer, counts);
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter = &filter;
+
+		while (plxDecoderNext(&decoder, &batch)) formatSplitBatch(options, &batch, frequency, &writer, counts);
+
+		counts->bytes = reader->offset;
+	}
+
+	result = plxSplitClose(&writer);
+
+	if (writer.reopens > 0) printInfo(options, " Reopened split files %lld times (%d open at most) ...\n", writer.reopens, writer.maxOpen);
+
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Write spike blocks as .npy column files (see plxnpy.h). The arrays are
+// presized from the file header counters unless a filter is given.
+int convertNpy(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxNpyWriter writer;
+	struct PlxFilter filter;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+	int result;
+
+	if (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * reader->fileHeader.NumPointsWave) != 0) return PLX_ERR_MEMORY;
+
+	result = plxNpyOpen(&writer, reader, baseName, !options->useFilter, options->scale);
+	if (result != 0) {
+		plxBatchFree(&batch);
+		return result;
+	}
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(1);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (plxIndexNextRange(index, &filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &filter;
+
+			while (plxDecoderNext(&decoder, &batch)) plxNpyBatch(&writer, &batch);
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter = &filter;
+
+		while (plxDecoderNext(&decoder, &batch)) plxNpyBatch(&writer, &batch);
+
+		counts->bytes = reader->offset;
+	}
+
+	counts->spikes += (int) writer.rows;
+
+	result = plxNpyClose(&writer);
+
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Write up to options->sample randomly chosen waveforms per channel and
+// unit (see plxsample.h) into <input>.sample.csv, or the -out file. Only
+// the payloads of the chosen blocks are read.
+int convertSample(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxSample sample;
+	struct PlxOutBuf csvOut;
+	struct PlxFilter filter;
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	unsigned __int64 start, end, seed;
+	__int64 position = 0;
+	char csvOutFileName[1024];
+	FILE *csvOutFile;
+	int result = 0;
+
+	// a fresh seed per run unless -seed is given; it is kept in the csv header
+	seed = options->hasSeed ? options->seed : ((unsigned __int64) time(NULL) << 20) ^ (unsigned __int64) getpid();
+
+	plxSampleInit(&sample, reader, options->sample, seed);
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(1);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while ((result == 0) && plxIndexNextRange(index, &filter, &position, &start, &end)) {
+			plxReaderView(reader, &view, start, end);
+			result = plxSampleRead(&sample, &view, &filter);
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		result = plxSampleRead(&sample, reader, &filter);
+		counts->bytes = reader->offset;
+	}
+
+	counts->spikes += (int) sample.spikes;
+
+	if (result != 0) {
+		plxSampleFree(&sample);
+		return result;
+	}
+
+	if (options->outFileName != NULL) snprintf(csvOutFileName, sizeof(csvOutFileName), "%s", options->outFileName);
+	else snprintf(csvOutFileName, sizeof(csvOutFileName), "%s.sample.csv", baseName);
+
+	csvOutFile = strcmp(csvOutFileName, "-") ? fopen(csvOutFileName, "w") : stdout;
+	if (csvOutFile == NULL) {
+		plxSampleFree(&sample);
+		return PLX_ERR_OPEN;
+	}
+
+	if (plxOutBufInit(&csvOut, csvOutFile, PLX_OUTBUF_SIZE) != 0) {
+		result = PLX_ERR_MEMORY;
+	} else {
+
+		if (options->noHeader != 1) {
+			fprintf(csvOutFile, "# PLX File Version (%d)\n\n", fileHeader->Version);
+			fprintf(csvOutFile, "# ADFrequency=%d\n", fileHeader->ADFrequency);
+			fprintf(csvOutFile, "# NumPointsWave=%d\n", fileHeader->NumPointsWave);
+			fprintf(csvOutFile, "# NumPointsPreThr=%d\n", fileHeader->NumPointsPreThr);
+			fprintf(csvOutFile, "# Sample=%d\n", sample.size);
+			fprintf(csvOutFile, "# Seed=%llu\n\n", seed);
+			fprintf(csvOutFile, "# Time (Seconds); Channel; Unit; Data\n");
+		}
+
+		if (plxSampleWrite(&sample, &csvOut, fileHeader->ADFrequency, options->scale) != 0) result = -1;
+
+		plxOutBufFree(&csvOut);
+		if (csvOut.error) result = -1;
+	}
+
+	if (csvOutFile == stdout) {
+		if ((fflush(stdout) != 0) || ferror(stdout)) result = -1;
+	} else if (fclose(csvOutFile) != 0) {
+		result = -1;
+	}
+
+	if (result == 0) printInfo(options, " Read %lld of %lld spike waveforms ...\n", sample.payloads, sample.spikes);
+
+	plxSampleFree(&sample);
+
+	return result;
+}
+
+// Write per-spike waveform features as .npy column files (see
+// plxfeatures.h). Like convertNpy, but only the first waveform of each
+// spike is reduced to one row of features.
+int convertFeatures(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxFeatureWriter writer;
+	struct PlxFilter filter;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+	int result;
+
+	if (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * reader->fileHeader.NumPointsWave) != 0) return PLX_ERR_MEMORY;
+
+	result = plxFeaturesOpen(&writer, reader, baseName, !options->useFilter, options->pcaComponents, options->scale);
+	if (result != 0) {
+		plxBatchFree(&batch);
+		return result;
+	}
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(1);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (!writer.error && plxIndexNextRange(index, &filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &filter;
+
+			while (!writer.error && plxDecoderNext(&decoder, &batch)) plxFeaturesBatch(&writer, &batch);
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter = &filter;
+
+		while (!writer.error && plxDecoderNext(&decoder, &batch)) plxFeaturesBatch(&writer, &batch);
+
+		counts->bytes = reader->offset;
+	}
+
+	result = plxFeaturesClose(&writer);
+
+	counts->spikes += (int) writer.rows;
+
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Join the A/D blocks of every continuous channel into one file per
+// channel (see plxslow.h). Only one batch and one small output buffer per
+// channel are held in memory, independent of the recording length.
+int convertSlow(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts)
+{
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxSlowWriter writer;
+	struct PlxFilter filter;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+	int result;
+
+	if (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * reader->fileHeader.NumPointsWave) != 0) return PLX_ERR_MEMORY;
+
+	result = plxSlowOpen(&writer, reader, baseName, options->slowFormat);
+	if (result != 0) {
+		plxBatchFree(&batch);
+		return result;
+	}
+
+	filter = options->filter;
+	filter.types = PLX_TYPE_BIT(5);
+
+	if (index != NULL) {
+
+		counts->bytes = reader->dataOffset;
+
+		while (plxIndexNextRange(index, &filter, &position, &start, &end)) {
+
+			plxReaderView(reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &filter;
+
+			while (plxDecoderNext(&decoder, &batch)) {
+				counts->slow += batch.count;
+				plxSlowBatch(&writer, &batch);
+			}
+
+			counts->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, reader);
+		decoder.filter = &filter;
+
+		while (plxDecoderNext(&decoder, &batch)) {
+			counts->slow += batch.count;
+			plxSlowBatch(&writer, &batch);
+		}
+
+		counts->bytes = reader->offset;
+	}
+
+	if (writer.unknownBlocks > 0) printInfo(options, " Skipped %lld continuous blocks without channel header ...\n", writer.unknownBlocks);
+
+	result = plxSlowClose(&writer);
+
+	plxBatchFree(&batch);
+
+	return result;
+}
+
+// Parse channel or unit list like "1,3,5-8" into filter
+void parseList(struct PlxFilter *filter, const char *list, void (*add)(struct PlxFilter *filter, int number))
+{
+	char *next;
+	long first, last;
+
+	while (*list != '\0') {
+
+		first = strtol(list, &next, 10);
+		if (next == list) break;
+
+		last = first;
+		if (*next == '-') {
+			list = next + 1;
+			last = strtol(list, &next, 10);
+			if (next == list) last = first;
+		}
+
+		for (; first <= last; first++) add(filter, (int) first);
+
+		list = next;
+		if (*list == ',') list++;
+	}
+}
+
+// Format the selected blocks of a batch as CSV rows and count them
+void formatCsvBatch(const struct PlxOptions *options, const struct PlxBatch *batch, int frequency, struct PlxOutBuf *out, struct PlxCounts *counts)
+{
+	int j;
+
+	for (j = 0; j < batch->count; j++) {
+
+		// extract spike channel data
+		if ((batch->type[j] == 1) && (options->spikeChannel == 1)) {
+			
+			// format time stamp, channel, unit and waveform into output buffer
+			if (options->scale != NULL) plxFormatCsvRowScaled(out, batch, j, frequency, options->scale);
+			else plxFormatCsvRow(out, batch, j, frequency);
+
+			// count number of spike events
+			counts->spikes++;
+
+		// event and slow channels are written by convertEvents() and convertSlow()
+		} else if (batch->type[j] == 4) {
+			counts->events++;
+		} else if (batch->type[j] == 5) {
+			counts->slow++;
+		}
+	}
 }
 
 void printUsage(void)
@@ -258,11 +1759,43 @@ void printUsage(void)
            "plx2csv version 0.1.1, Copyright (c) 2011 by Gerold Bausch\n"\
            "  built on %s %s with gcc %d.%d.%d\n\n"\
            "Plexon file to CSV file converter.\n"\
-           "Usage: plx2csv <inputfile> [channel] [options]\n\n"\
+           "Usage: plx2csv <inputfile|-> [inputfile ...] [channel] [options]\n"\
+           "  .ddt input files are written into one file per channel (csv or -format bin)\n\n"\
            "Options:\n"\
            "  -spikechannel : extract spike channel only (default)\n"\
-           "  -eventchannel : extract event channel only\n"\
-           "  -slowchannel  : extract slow channel only\n"\
+           "  -eventchannel : extract event channel only (time, event, strobe, name)\n"\
+           "  -slowchannel  : extract slow channels into one csv file per channel\n"\
+           "  -slowbin      : extract slow channels into one binary file (int16) per channel\n"\
            "  -noheader     : create csv file without header information\n"\
-           "  -headerfile   : create separate file for header information\n", __DATE__, __TIME__, __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+           "  -headerfile   : create separate file for header information\n"\
+           "  -format F     : write spikes as csv (default) or bin (.npy columns)\n"\
+           "  -split S      : write spikes to one csv file per channel or unit (channel, unit)\n"\
+           "  -trains       : write spike timestamps per channel and unit as .npy arrays\n"\
+           "  -bin MS       : with -trains, also write spike counts in bins of MS milliseconds\n"\
+           "  -features     : write peak, trough, width and energy per spike instead of waveforms (.npy)\n"\
+           "  -pca K        : with -features, also project each spike on K principal components (1..8)\n"\
+           "  -sample N     : write N randomly chosen waveforms per channel and unit (<inputfile>.sample.csv)\n"\
+           "  -seed S       : with -sample, seed of the random numbers (default: new each run)\n"\
+           "  -scale U      : spike waveforms as raw ADC values (raw, default) or microvolts (uV)\n"\
+           "  -out F        : write csv rows to F, - for stdout (default <inputfile>.csv, stdin: -)\n"\
+           "  -fread        : read input with fread instead of mmap\n"\
+           "  -threads N    : format csv rows on N threads\n"\
+           "  -from S       : extract blocks from S seconds on\n"\
+           "  -to S         : extract blocks before S seconds\n"\
+           "  -channels L   : extract channels in list L only (e.g. 1,3,5-8)\n"\
+           "  -units L      : extract sorted units in list L only (e.g. 0-2)\n"\
+           "  -summary      : write channel names and header counts as json and exit\n"\
+           "  -verify       : like -summary, also count the blocks and find the last timestamp\n"\
+           "  -resume       : append the blocks added since the last run (checkpoint <output>.resume)\n"\
+           "  -follow S     : like -resume, again every S seconds until interrupted (growing files)\n"\
+           "  -merge        : merge all input files into one csv file ordered by timestamp (raw ADC values)\n"\
+           "  -renumber L   : with -merge, add channel offsets per file (e.g. 0,32,64, auto: no overlap)\n"\
+           "  -index        : build block index file for -from/-to/-channels and exit\n"\
+           "  -manifest F   : also convert the files listed in F (one per line)\n"\
+           "  -jobs N       : convert N files at the same time (several inputs)\n"\
+           "  -budget MB    : convert at most MB megabytes of input at the same time\n"\
+           "  -report F     : write per file status of several inputs to F (plx2csv.report.csv)\n"\
+           "  -stats F      : time per phase, block histograms and peak memory as text or json\n"\
+           "                  (<inputfile>.stats.json), with progress every 2 s on stderr\n"\
+           "  -progress S   : print progress and time left on stderr every S seconds (0: off)\n", __DATE__, __TIME__, __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
 }
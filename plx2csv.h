@@ -38,11 +38,130 @@
 #pragma once
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
+#include <time.h>
+#include <math.h>
 
 #include "Plexon.h"
+#include "plxreader.h"
+#include "plxdecode.h"
+#include "plxformat.h"
+#include "plxindex.h"
+#include "plxslow.h"
+#include "plxevent.h"
+#include "plxnpy.h"
+#include "plxscale.h"
+#include "plxsplit.h"
+#include "plxsummary.h"
+#include "plxddt.h"
+#include "plxstats.h"
+#include "plxtrains.h"
+#include "plxresume.h"
+#include "plxfeatures.h"
+#include "plxmerge.h"
+#include "plxsample.h"
+
+// Upper limit for -threads
+#define PLX_MAX_THREADS		64
+
+// -stats reports
+#define PLX_STATS_NONE		0
+#define PLX_STATS_TEXT		1			// table on the command line
+#define PLX_STATS_JSON		2			// <input>.stats.json, json progress lines
+
+// Command line options
+struct PlxOptions
+{
+	char 	noHeader;					// create csv file without header information
+	char 	headerFile;					// create separate file for header information
+	char 	spikeChannel;				// extract spike channel
+	char 	eventChannel;				// extract event channel
+	char 	slowChannel;				// extract slow channel
+	int 	slowFormat;					// PLX_FORMAT_CSV or PLX_FORMAT_BIN for slow channel files
+	int 	format;						// PLX_FORMAT_CSV or PLX_FORMAT_BIN
+	int 	split;						// PLX_SPLIT_NONE, PLX_SPLIT_CHANNEL or PLX_SPLIT_UNIT
+	char 	trains;						// spike timestamps per channel and unit as .npy arrays
+	double 	binWidth;					// spike count matrix bin width in seconds (0: none)
+	char 	features;					// per-spike waveform features instead of waveforms
+	int 	pcaComponents;				// principal component projections per spike (0: none)
+	int 	sample;						// waveforms sampled per channel and unit (0: all spikes)
+	unsigned __int64 seed;				// -sample random seed
+	char 	hasSeed;					// -seed given
+	char 	scaleMicrovolts;			// -scale uV given
+	const struct PlxScaleTable *scale;	// spike waveform scale table or NULL for raw samples
+	int 	readerMode;					// PLX_READER_MMAP or PLX_READER_STDIO
+	int 	threads;					// number of formatting threads
+	const char *outFileName;			// csv output file, "-" for stdout (NULL: <input>.csv)
+	int 	jobs;						// number of files converted at the same time
+	unsigned __int64 budget;			// input bytes converted at the same time (0: no limit)
+	char 	quiet;						// no progress messages (batch mode)
+	char 	merge;						// all inputs into one csv file ordered by timestamp
+	const char *renumber;				// channel offsets per input for -merge ("auto" or a list)
+	char 	resume;						// continue from the checkpoint of the last run
+	double 	follow;						// seconds between runs on a growing file (0: one run)
+	int 	stats;						// PLX_STATS_NONE, PLX_STATS_TEXT or PLX_STATS_JSON
+	double 	progress;					// seconds between progress lines on stderr (0: none)
+	char 	buildIndex;					// (re)build the block index and exit
+	char 	summary;					// write the file inventory and exit
+	char 	verify;						// check the inventory against the data blocks
+	char 	useFilter;					// -from, -to or -channels given
+	double 	from;						// start of time window in seconds
+	double 	to;							// end of time window in seconds (< 0: open)
+	struct PlxFilter filter;			// block filter derived from the options above
+};
+
+// Number of converted blocks by type
+struct PlxCounts
+{
+	int 	spikes;
+	int 	events;
+	int 	slow;
+	unsigned __int64 bytes;				// input bytes read
+};
+
+// Result of converting one file
+struct PlxReport
+{
+	const char 	*fileName;
+	unsigned __int64 size;				// input file size
+	int 		status;					// 0 or -1 if an error occurred
+	char 		error[256];				// first error message
+	int 		truncated;				// incomplete block at the end of the file
+	double 		elapsed;				// conversion time in seconds
+	struct PlxCounts counts;
+};
 
 // Function prototypes
 void printUsage(void);
+int  addInput(char ***inputs, int *numInputs, int *capacity, const char *fileName);
+int  readManifest(char ***inputs, int *numInputs, int *capacity, const char *fileName);
+void printInfo(const struct PlxOptions *options, const char *format, ...);
+void printError(const struct PlxOptions *options, struct PlxReport *report, const char *format, ...);
+FILE *openCsvOutput(const struct PlxOptions *options, struct PlxReader *reader, const char *csvOutFileName, struct PlxResume *resume);
+void printStats(const struct PlxOptions *options, struct PlxReport *report, const struct PlxStats *stats, const char *baseName);
+int  convertFile(const char *fileName, const struct PlxOptions *cmdOptions, struct PlxReport *report);
+int  mergeFiles(const char **fileNames, int numFiles, const struct PlxOptions *cmdOptions, struct PlxReport *report);
+int  followFile(const char *fileName, const struct PlxOptions *options, struct PlxReport *report);
+int  convertDdt(const char *fileName, const char *baseName, const struct PlxOptions *options, struct PlxReport *report);
+int  convertCsvSerial(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, FILE *csvOutFile, struct PlxCounts *counts);
+int  convertEvents(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, FILE *csvOutFile, struct PlxCounts *counts);
+int  convertNpy(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts);
+int  convertSplit(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts);
+int  convertSlow(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts);
+int  convertSample(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts);
+int  convertFeatures(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts);
+int  convertTrains(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, const char *baseName, struct PlxCounts *counts);
+void parseList(struct PlxFilter *filter, const char *list, void (*add)(struct PlxFilter *filter, int number));
+void formatCsvBatch(const struct PlxOptions *options, const struct PlxBatch *batch, int frequency, struct PlxOutBuf *out, struct PlxCounts *counts);
+
+// plxparallel.c
+int  convertCsvParallel(struct PlxReader *reader, const struct PlxOptions *options, FILE *csvOutFile, struct PlxCounts *counts);
+
+// plxpipeline.c
+int  convertCsvPipeline(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, FILE *csvOutFile, struct PlxCounts *counts);
+
+// plxjobs.c
+int  convertBatch(const char **fileNames, int numFiles, const struct PlxOptions *options, const char *reportFileName);
 
 #endif
\ No newline at end of file
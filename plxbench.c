@@ -0,0 +1,281 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+// plxbench: runs plx2csv in several modes over a corpus of plx files and
+// reports wall time, MB/s, blocks/s and peak resident memory per run.
+// Each file is linked into a work directory whose outputs are removed
+// after every run; the best of -runs runs is reported.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "plxsummary.h"
+
+#define PLX_BENCH_MAX_ARGS		8
+
+// Benchmarked plx2csv modes
+struct PlxBenchMode
+{
+	const char 	*name;
+	const char 	*args[PLX_BENCH_MAX_ARGS];		// "@threads" is replaced by the number of cores
+};
+
+static const struct PlxBenchMode plxBenchModes[] =
+{
+	{ "csv",         { NULL } },
+	{ "csv-fread",   { "-fread", NULL } },
+	{ "csv-threads", { "-threads", "@threads", NULL } },
+	{ "scale-uV",    { "-scale", "uV", NULL } },
+	{ "bin",         { "-format", "bin", NULL } },
+	{ "split-unit",  { "-split", "unit", NULL } },
+	{ "events",      { "-eventchannel", NULL } },
+	{ "slow",        { "-slowchannel", NULL } },
+	{ "channel-1",   { "-channels", "1", NULL } },
+	{ "verify",      { "-verify", NULL } },
+};
+
+#define PLX_BENCH_NUM_MODES		((int)(sizeof(plxBenchModes) / sizeof(plxBenchModes[0])))
+
+// Result of one run
+struct PlxBenchRun
+{
+	double 	seconds;
+	long 	maxRss;						// peak resident memory in KB
+	int 	status;						// exit status of plx2csv
+};
+
+// Remove everything but the input and its index from the work directory
+static void plxBenchClean(const char *workDir)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir(workDir);
+	if (dir == NULL) return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+		if (!strcmp(entry->d_name, "bench.plx") || !strcmp(entry->d_name, "bench.plx.plxidx")) continue;
+
+		snprintf(path, sizeof(path), "%s/%s", workDir, entry->d_name);
+		unlink(path);
+	}
+
+	closedir(dir);
+}
+
+// Run plx2csv once with its output discarded
+static void plxBenchRun(const char *plx2csv, const char *input, const struct PlxBenchMode *mode, const char *threads, const char *workDir, struct PlxBenchRun *run)
+{
+	const char *argv[PLX_BENCH_MAX_ARGS + 3];
+	struct timespec tStart, tEnd;
+	struct rusage usage;
+	pid_t pid;
+	int i, n = 0, status, devNull;
+
+	argv[n++] = plx2csv;
+	argv[n++] = input;
+	for (i = 0; mode->args[i] != NULL; i++) argv[n++] = strcmp(mode->args[i], "@threads") ? mode->args[i] : threads;
+	argv[n] = NULL;
+
+	run->status = -1;
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	pid = fork();
+	if (pid == 0) {
+		devNull = open("/dev/null", O_WRONLY);
+		if (devNull >= 0) {
+			dup2(devNull, STDOUT_FILENO);
+			dup2(devNull, STDERR_FILENO);
+		}
+		if (chdir(workDir) != 0) _exit(126);
+		execv(plx2csv, (char* const*) argv);
+		_exit(127);
+	}
+	if (pid < 0) return;
+
+	if (wait4(pid, &status, 0, &usage) != pid) return;
+	clock_gettime(CLOCK_MONOTONIC, &tEnd);
+
+	run->seconds = (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) * 1e-9;
+	run->maxRss  = usage.ru_maxrss;
+	run->status  = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+	plxBenchClean(workDir);
+}
+
+static int plxBenchSelected(const char *modes, const char *name)
+{
+	size_t length = strlen(name);
+	const char *p = modes;
+
+	if (modes == NULL) return 1;
+
+	while ((p = strstr(p, name)) != NULL) {
+		if (((p == modes) || (p[-1] == ',')) && ((p[length] == ',') || (p[length] == '\0'))) return 1;
+		p += length;
+	}
+
+	return 0;
+}
+
+static void printUsage(void)
+{
+	fprintf(stdout, "\nplxbench - plx2csv throughput benchmark\n"\
+           "Usage: plxbench [options] <file.plx> [file.plx ...]\n\n"\
+           "Options:\n"\
+           "  -plx2csv P    : plx2csv executable (./plx2csv)\n"\
+           "  -runs N       : runs per mode, the best one is reported (3)\n"\
+           "  -modes L      : comma separated list of modes (all)\n"\
+           "  -workdir D    : directory for the outputs (bench.work)\n"\
+           "  -report F     : also write the results as csv to F\n\n"\
+           "Modes: csv, csv-fread, csv-threads, scale-uV, bin, split-unit, events, slow, channel-1, verify\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *plx2csv = "./plx2csv";
+	const char *modes = NULL;
+	const char *workDir = "bench.work";
+	const char *reportFileName = NULL;
+	char executable[PATH_MAX], input[PATH_MAX], link[PATH_MAX], threads[16];
+	struct PlxReader reader;
+	struct PlxSummaryVerify verify;
+	struct PlxBenchRun run, best;
+	FILE *reportFile = NULL;
+	double megabytes;
+	int runs = 3, failed = 0;
+	int i, m, r;
+
+	for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+		if (!strcmp("-plx2csv", argv[i]) && (i + 1 < argc)) plx2csv = argv[++i];
+		else if (!strcmp("-runs", argv[i]) && (i + 1 < argc)) runs = atoi(argv[++i]);
+		else if (!strcmp("-modes", argv[i]) && (i + 1 < argc)) modes = argv[++i];
+		else if (!strcmp("-workdir", argv[i]) && (i + 1 < argc)) workDir = argv[++i];
+		else if (!strcmp("-report", argv[i]) && (i + 1 < argc)) reportFileName = argv[++i];
+	}
+
+	if ((i >= argc) || (runs < 1)) {
+		printUsage();
+		return 1;
+	}
+
+	// plx2csv runs inside the work directory
+	if (realpath(plx2csv, executable) == NULL) {
+		fprintf(stderr, "Error: Cannot find '%s'.\n", plx2csv);
+		return 1;
+	}
+	mkdir(workDir, 0755);
+
+	snprintf(threads, sizeof(threads), "%ld", sysconf(_SC_NPROCESSORS_ONLN));
+	snprintf(link, sizeof(link), "%s/bench.plx", workDir);
+
+	if (reportFileName != NULL) {
+		reportFile = fopen(reportFileName, "w");
+		if (reportFile == NULL) {
+			fprintf(stderr, "Error: Cannot open report file.\n");
+			return 1;
+		}
+		fprintf(reportFile, "File,Mode,MB,Blocks,Seconds,MB/s,Blocks/s,PeakRSS MB,Status\n");
+	}
+
+	fprintf(stdout, "%-24s %-12s %9s %12s %8s %9s %12s %9s\n", "File", "Mode", "MB", "Blocks", "Seconds", "MB/s", "Blocks/s", "RSS MB");
+
+	for (; i < argc; i++) {
+
+		// size and number of data blocks of the input
+		if ((realpath(argv[i], input) == NULL) || (plxReaderOpen(&reader, input, PLX_READER_MMAP) != 0)) {
+			fprintf(stderr, "Error: Cannot open plx file '%s'.\n", argv[i]);
+			failed++;
+			continue;
+		}
+		plxSummaryVerify(&verify, &reader);
+		megabytes = reader.size / 1e6;
+		plxReaderClose(&reader);
+
+		plxBenchClean(workDir);
+		unlink(link);
+		if (symlink(input, link) != 0) {
+			fprintf(stderr, "Error: Cannot link '%s' into '%s'.\n", argv[i], workDir);
+			failed++;
+			continue;
+		}
+
+		for (m = 0; m < PLX_BENCH_NUM_MODES; m++) {
+
+			if (!plxBenchSelected(modes, plxBenchModes[m].name)) continue;
+
+			memset(&best, 0, sizeof(struct PlxBenchRun));
+			best.seconds = -1;
+
+			for (r = 0; r < runs; r++) {
+				plxBenchRun(executable, "bench.plx", &plxBenchModes[m], threads, workDir, &run);
+				if (run.status != 0) {
+					best = run;
+					break;
+				}
+				if ((best.seconds < 0) || (run.seconds < best.seconds)) best.seconds = run.seconds;
+				if (run.maxRss > best.maxRss) best.maxRss = run.maxRss;
+			}
+
+			if (best.status != 0) {
+				fprintf(stdout, "%-24.24s %-12s failed (exit status %d)\n", argv[i], plxBenchModes[m].name, best.status);
+				failed++;
+			} else {
+				fprintf(stdout, "%-24.24s %-12s %9.1f %12lld %8.3f %9.1f %12.0f %9.1f\n", argv[i], plxBenchModes[m].name,
+					megabytes, verify.blocks, best.seconds, megabytes / best.seconds, verify.blocks / best.seconds, best.maxRss / 1024.0);
+			}
+			fflush(stdout);
+
+			if (reportFile != NULL) {
+				fprintf(reportFile, "\"%s\",%s,%.1f,%lld,%.3f,%.1f,%.0f,%.1f,%d\n", argv[i], plxBenchModes[m].name,
+					megabytes, verify.blocks, best.seconds, (best.seconds > 0) ? megabytes / best.seconds : 0.0,
+					(best.seconds > 0) ? verify.blocks / best.seconds : 0.0, best.maxRss / 1024.0, best.status);
+			}
+		}
+
+		unlink(link);
+		snprintf(link, sizeof(link), "%s/bench.plx.plxidx", workDir);
+		unlink(link);
+		snprintf(link, sizeof(link), "%s/bench.plx", workDir);
+	}
+
+	if ((reportFile != NULL) && (fclose(reportFile) != 0)) {
+		fprintf(stderr, "Error: Cannot write report file.\n");
+		failed++;
+	}
+
+	rmdir(workDir);
+
+	return (failed > 0) ? 1 : 0;
+}
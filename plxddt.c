@@ -0,0 +1,417 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PLX_DDT_X86
+#endif
+
+#include "plxddt.h"
+
+// .ddt files carry no magic number, they are recognized by their extension
+int plxDdtFileName(const char *fileName)
+{
+	size_t length = strlen(fileName);
+
+	return (length > 4) && !strcasecmp(fileName + length - 4, ".ddt");
+}
+
+int plxDdtOpen(struct PlxDdtReader *reader, const char *fileName)
+{
+	const struct DigFileHeader *header = &reader->header;
+	struct stat st;
+	void *map;
+	int i, enabled = 0;
+
+	memset(reader, 0, sizeof(struct PlxDdtReader));
+	reader->fd = -1;
+
+	reader->fd = open(fileName, O_RDONLY);
+	if (reader->fd < 0) return PLX_ERR_OPEN;
+
+	if ((fstat(reader->fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+		plxDdtClose(reader);
+		return PLX_ERR_OPEN;
+	}
+
+	if ((unsigned __int64) st.st_size < sizeof(struct DigFileHeader)) {
+		plxDdtClose(reader);
+		return PLX_ERR_INVALID;
+	}
+
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+	if (map == MAP_FAILED) {
+		plxDdtClose(reader);
+		return PLX_ERR_OPEN;
+	}
+
+	// frames are walked front to back exactly once
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+	reader->map  = (const unsigned char*) map;
+	reader->size = (unsigned __int64) st.st_size;
+	memcpy(&reader->header, reader->map, sizeof(struct DigFileHeader));
+
+	if ((header->Version < 100) || (header->NChannels <= 0) || (header->NChannels > 64) || (header->Freq <= 0) ||
+		(header->DataOffset < (int) sizeof(struct DigFileHeader)) || ((unsigned __int64) header->DataOffset > reader->size)) {
+		plxDdtClose(reader);
+		return PLX_ERR_INVALID;
+	}
+
+	reader->frameWidth = header->NChannels;
+	reader->numFrames  = (__int64)((reader->size - header->DataOffset) / (reader->frameWidth * sizeof(short)));
+	reader->truncated  = (reader->size - header->DataOffset) % (reader->frameWidth * sizeof(short)) != 0;
+	reader->adviseOffset = header->DataOffset;
+
+	for (i = 0; (header->Version >= 102) && (i < 64); i++) {
+		if (header->ChannelGain[i] != PLX_DDT_DISABLED) enabled++;
+	}
+
+	if ((header->Version >= 102) && (enabled == reader->frameWidth)) {
+
+		// frames hold the enabled channels only
+		for (i = 0; i < 64; i++) {
+			if (header->ChannelGain[i] == PLX_DDT_DISABLED) continue;
+			reader->channel[reader->numChannels] = i + 1;
+			reader->column[reader->numChannels]  = reader->numChannels;
+			reader->gain[reader->numChannels]    = header->ChannelGain[i];
+			reader->numChannels++;
+		}
+
+	} else {
+
+		// frames hold channels 1..NChannels, disabled ones are dropped
+		for (i = 0; i < reader->frameWidth; i++) {
+			if ((header->Version >= 102) && (header->ChannelGain[i] == PLX_DDT_DISABLED)) continue;
+			reader->channel[reader->numChannels] = i + 1;
+			reader->column[reader->numChannels]  = i;
+			reader->gain[reader->numChannels]    = (header->Version >= 102) ? header->ChannelGain[i] : 1;
+			reader->numChannels++;
+		}
+	}
+
+	return 0;
+}
+
+// Get up to maxFrames complete frames. Returns the number of frames, 0 at
+// the end of the file. The frames point into the mapping.
+int plxDdtNext(struct PlxDdtReader *reader, const short **ppFrames, int maxFrames)
+{
+	unsigned __int64 page = (unsigned __int64) sysconf(_SC_PAGESIZE);
+	unsigned __int64 offset, start, end;
+	__int64 count = reader->numFrames - reader->frame;
+
+	if (count > maxFrames) count = maxFrames;
+	if (count <= 0) return 0;
+
+	offset = reader->header.DataOffset + (unsigned __int64) reader->frame * reader->frameWidth * sizeof(short);
+	*ppFrames = (const short*)(reader->map + offset);
+	reader->frame += count;
+
+	// drop the pages read so far every PLX_READER_WINDOW bytes
+	if (offset >= reader->adviseOffset + PLX_READER_WINDOW) {
+		start = reader->adviseOffset & ~(page - 1);
+		end   = offset & ~(page - 1);
+		if (end > start) madvise((void*)(reader->map + start), (size_t)(end - start), MADV_DONTNEED);
+		reader->adviseOffset = end;
+	}
+
+	return (int) count;
+}
+
+void plxDdtClose(struct PlxDdtReader *reader)
+{
+	if (reader->map != NULL) munmap((void*) reader->map, (size_t) reader->size);
+	if (reader->fd >= 0) close(reader->fd);
+
+	memset(reader, 0, sizeof(struct PlxDdtReader));
+	reader->fd = -1;
+}
+
+static void plxDdtDeinterleaveGeneric(short *const *dst, const short *frames, int numFrames, int frameWidth, int first, int last)
+{
+	int c, k;
+
+	for (c = first; c < last; c++) {
+		if (dst[c] == NULL) continue;
+		for (k = 0; k < numFrames; k++) dst[c][k] = frames[(size_t) k * frameWidth + c];
+	}
+}
+
+#ifdef PLX_DDT_X86
+
+// Transpose 8 rows of 8 shorts: r[i] holds frame i, afterwards column i
+#define PLX_TRANSPOSE8(unpacklo16, unpackhi16, unpacklo32, unpackhi32, unpacklo64, unpackhi64, r, t) \
+	t[0] = unpacklo16(r[0], r[1]); t[1] = unpackhi16(r[0], r[1]); \
+	t[2] = unpacklo16(r[2], r[3]); t[3] = unpackhi16(r[2], r[3]); \
+	t[4] = unpacklo16(r[4], r[5]); t[5] = unpackhi16(r[4], r[5]); \
+	t[6] = unpacklo16(r[6], r[7]); t[7] = unpackhi16(r[6], r[7]); \
+	r[0] = unpacklo32(t[0], t[2]); r[1] = unpackhi32(t[0], t[2]); \
+	r[2] = unpacklo32(t[1], t[3]); r[3] = unpackhi32(t[1], t[3]); \
+	r[4] = unpacklo32(t[4], t[6]); r[5] = unpackhi32(t[4], t[6]); \
+	r[6] = unpacklo32(t[5], t[7]); r[7] = unpackhi32(t[5], t[7]); \
+	t[0] = unpacklo64(r[0], r[4]); t[1] = unpackhi64(r[0], r[4]); \
+	t[2] = unpacklo64(r[1], r[5]); t[3] = unpackhi64(r[1], r[5]); \
+	t[4] = unpacklo64(r[2], r[6]); t[5] = unpackhi64(r[2], r[6]); \
+	t[6] = unpacklo64(r[3], r[7]); t[7] = unpackhi64(r[3], r[7]);
+
+// 8 frames x 8 columns per step
+__attribute__((target("sse2")))
+static void plxDdtDeinterleaveSSE2(short *const *dst, const short *frames, int numFrames, int frameWidth)
+{
+	__m128i r[8], t[8];
+	int c, i, k;
+
+	for (c = 0; c + 8 <= frameWidth; c += 8) {
+		for (k = 0; k + 8 <= numFrames; k += 8) {
+
+			for (i = 0; i < 8; i++) r[i] = _mm_loadu_si128((const __m128i*)(frames + (size_t)(k + i) * frameWidth + c));
+
+			PLX_TRANSPOSE8(_mm_unpacklo_epi16, _mm_unpackhi_epi16, _mm_unpacklo_epi32, _mm_unpackhi_epi32,
+				_mm_unpacklo_epi64, _mm_unpackhi_epi64, r, t)
+
+			for (i = 0; i < 8; i++) {
+				if (dst[c + i] != NULL) _mm_storeu_si128((__m128i*)(dst[c + i] + k), t[i]);
+			}
+		}
+
+		// remaining frames of these columns
+		for (i = 0; i < 8; i++) {
+			if (dst[c + i] == NULL) continue;
+			for (k = numFrames & ~7; k < numFrames; k++) dst[c + i][k] = frames[(size_t) k * frameWidth + c + i];
+		}
+	}
+
+	plxDdtDeinterleaveGeneric(dst, frames, numFrames, frameWidth, c, frameWidth);
+}
+
+// 16 frames x 8 columns per step: frames k..k+7 in the low lane, k+8..k+15
+// in the high lane, so the per lane unpacks give two 8x8 transposes
+__attribute__((target("avx2")))
+static void plxDdtDeinterleaveAVX2(short *const *dst, const short *frames, int numFrames, int frameWidth)
+{
+	__m256i r[8], t[8];
+	const short *row;
+	int c, i, k, blocks = numFrames & ~15;
+
+	for (c = 0; c + 8 <= frameWidth; c += 8) {
+		for (k = 0; k < blocks; k += 16) {
+
+			for (i = 0; i < 8; i++) {
+				row  = frames + (size_t)(k + i) * frameWidth + c;
+				r[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) row)),
+					_mm_loadu_si128((const __m128i*)(row + (size_t) 8 * frameWidth)), 1);
+			}
+
+			PLX_TRANSPOSE8(_mm256_unpacklo_epi16, _mm256_unpackhi_epi16, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32,
+				_mm256_unpacklo_epi64, _mm256_unpackhi_epi64, r, t)
+
+			for (i = 0; i < 8; i++) {
+				if (dst[c + i] != NULL) _mm256_storeu_si256((__m256i*)(dst[c + i] + k), t[i]);
+			}
+		}
+	}
+
+	if (blocks > 0) {
+		short *rest[64];
+
+		// remaining frames of all columns
+		for (i = 0; i < frameWidth; i++) rest[i] = (dst[i] != NULL) ? dst[i] + blocks : NULL;
+		plxDdtDeinterleaveSSE2(rest, frames + (size_t) blocks * frameWidth, numFrames - blocks, frameWidth);
+
+		// remaining columns of the frames done above
+		plxDdtDeinterleaveGeneric(dst, frames, blocks, frameWidth, frameWidth & ~7, frameWidth);
+	} else {
+		plxDdtDeinterleaveSSE2(dst, frames, numFrames, frameWidth);
+	}
+}
+
+#endif
+
+void plxDdtDeinterleave(short *const *dst, const short *frames, int numFrames, int frameWidth)
+{
+#ifdef PLX_DDT_X86
+	// the cpu features are detected once at startup by libgcc
+	if (__builtin_cpu_supports("avx2")) {
+		plxDdtDeinterleaveAVX2(dst, frames, numFrames, frameWidth);
+	} else if (__builtin_cpu_supports("sse2")) {
+		plxDdtDeinterleaveSSE2(dst, frames, numFrames, frameWidth);
+	} else {
+		plxDdtDeinterleaveGeneric(dst, frames, numFrames, frameWidth, 0, frameWidth);
+	}
+#else
+	plxDdtDeinterleaveGeneric(dst, frames, numFrames, frameWidth, 0, frameWidth);
+#endif
+}
+
+int plxDdtWriterOpen(struct PlxDdtWriter *writer, const struct PlxDdtReader *reader, const struct PlxFilter *filter, const char *baseName, int format)
+{
+	char fileName[1024];
+	unsigned short index;
+	int i;
+
+	memset(writer, 0, sizeof(struct PlxDdtWriter));
+
+	writer->format     = format;
+	writer->frequency  = reader->header.Freq;
+	writer->baseName   = baseName;
+	writer->frameWidth = reader->frameWidth;
+
+	// channels selected by the filter (-channels)
+	for (i = 0; i < reader->numChannels; i++) {
+		index = (unsigned short) reader->channel[i];
+		if ((filter != NULL) && !filter->allChannels && !(filter->channels[index >> 3] & (1 << (index & 7)))) continue;
+
+		writer->channel[writer->numChannels] = reader->channel[i];
+		writer->column[writer->numChannels]  = reader->column[i];
+		writer->gain[writer->numChannels]    = reader->gain[i];
+		writer->numChannels++;
+	}
+
+	// csv rows are formatted from de-interleaved columns
+	if (format == PLX_FORMAT_CSV) {
+		writer->samples = (short*) malloc ((size_t) writer->numChannels * PLX_DDT_FRAMES * sizeof(short) + 1);
+		if (writer->samples == NULL) return PLX_ERR_MEMORY;
+	}
+
+	for (i = 0; i < writer->numChannels; i++) {
+
+		snprintf(fileName, sizeof(fileName), "%s.ddt%03d.%s", baseName, writer->channel[i], (format == PLX_FORMAT_BIN) ? "bin" : "csv");
+
+		writer->files[i] = fopen(fileName, (format == PLX_FORMAT_BIN) ? "wb" : "w");
+		if ((writer->files[i] == NULL) || (plxOutBufInit(&writer->out[i], writer->files[i], PLX_DDT_OUTBUF_SIZE) != 0)) {
+			writer->error = 1;
+			plxDdtWriterClose(writer);
+			return PLX_ERR_OPEN;
+		}
+
+		if (format == PLX_FORMAT_CSV) {
+			writer->columns[i] = writer->samples + (size_t) i * PLX_DDT_FRAMES;
+			fprintf(writer->files[i], "# Channel %d, Gain=%d, Freq=%g\n", writer->channel[i], writer->gain[i], writer->frequency);
+			fprintf(writer->files[i], "# Time (Seconds); Value\n");
+		}
+	}
+
+	return 0;
+}
+
+// Append frames (at most PLX_DDT_FRAMES) to the channel files. Binary
+// samples are de-interleaved straight into the output buffers.
+void plxDdtWriterFrames(struct PlxDdtWriter *writer, const short *frames, int numFrames)
+{
+	short *dst[64];
+	char *p;
+	int i, j, k, n;
+
+	memset(dst, 0, sizeof(dst));
+
+	for (i = 0; i < writer->numChannels; i++) {
+		if (writer->format == PLX_FORMAT_BIN) {
+			dst[writer->column[i]] = (short*) plxOutBufReserve(&writer->out[i], (size_t) numFrames * sizeof(short));
+			if (dst[writer->column[i]] == NULL) {
+				writer->error = 1;
+				return;
+			}
+		} else {
+			dst[writer->column[i]] = writer->columns[i];
+		}
+	}
+
+	plxDdtDeinterleave(dst, frames, numFrames, writer->frameWidth);
+
+	for (i = 0; i < writer->numChannels; i++) {
+
+		if (writer->format == PLX_FORMAT_BIN) {
+			writer->out[i].used += (size_t) numFrames * sizeof(short);
+			continue;
+		}
+
+		// seconds + ',' + value + '\n' in pieces that fit the channel buffer
+		for (k = 0; k < numFrames; k += n) {
+
+			n = numFrames - k;
+			if (n > PLX_DDT_OUTBUF_SIZE / 352) n = PLX_DDT_OUTBUF_SIZE / 352;
+
+			p = plxOutBufReserve(&writer->out[i], (size_t) n * 352);
+			if (p == NULL) {
+				writer->error = 1;
+				return;
+			}
+
+			for (j = 0; j < n; j++) {
+				p = plxFormatFixed6(p, (double)(writer->numFrames + k + j) / writer->frequency);
+				*p++ = ',';
+				p = plxFormatInt(p, writer->columns[i][k + j]);
+				*p++ = '\n';
+			}
+			writer->out[i].used = p - writer->out[i].data;
+		}
+	}
+
+	writer->numFrames += numFrames;
+}
+
+// Flush and close all channel files and write the channel summary file
+int plxDdtWriterClose(struct PlxDdtWriter *writer)
+{
+	char fileName[1024];
+	FILE *summaryFile = NULL;
+	int i;
+
+	if (!writer->error) {
+		snprintf(fileName, sizeof(fileName), "%s.ddt.csv", writer->baseName);
+		summaryFile = fopen(fileName, "w");
+		if (summaryFile == NULL) writer->error = 1;
+		else fprintf(summaryFile, "Channel,Gain,Freq,Samples\n");
+	}
+
+	for (i = 0; i < writer->numChannels; i++) {
+
+		if (writer->files[i] == NULL) continue;
+
+		plxOutBufFree(&writer->out[i]);
+		if (fclose(writer->files[i]) != 0) writer->error = 1;
+		if (writer->out[i].error) writer->error = 1;
+		writer->files[i] = NULL;
+
+		if (summaryFile != NULL) {
+			fprintf(summaryFile, "%d,%d,%g,%lld\n", writer->channel[i], writer->gain[i], writer->frequency, writer->numFrames);
+		}
+	}
+
+	if ((summaryFile != NULL) && (fclose(summaryFile) != 0)) writer->error = 1;
+
+	free(writer->samples);
+	writer->samples = NULL;
+
+	return writer->error ? -1 : 0;
+}
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PLXDDT_H__
+#define __PLXDDT_H__
+
+#pragma once
+#include "plxformat.h"
+
+// Frames de-interleaved per step and output buffer per channel (bytes)
+#define PLX_DDT_FRAMES			4096
+#define PLX_DDT_OUTBUF_SIZE		(64 << 10)
+
+// Gain of a disabled channel (not recorded)
+#define PLX_DDT_DISABLED		255
+
+// Reader for .ddt continuous files. The file is mapped and its frames of
+// interleaved int16 samples (one per recorded channel) are handed out in
+// place. Version >= 102 files store the enabled channels only (gain not
+// 255); older files store channels 1..NChannels.
+struct PlxDdtReader
+{
+	int 	fd;
+	const unsigned char *map;			// mapped file
+	unsigned __int64 size;				// file size in bytes
+	unsigned __int64 adviseOffset;		// end of the last madvise window
+
+	struct DigFileHeader header;
+	int 	frameWidth;					// samples per frame
+	__int64 numFrames;					// complete frames in the file
+	__int64 frame;						// next frame
+	int 	truncated;					// incomplete frame at the end of the file
+
+	int 	numChannels;				// channels written
+	int 	channel[64];				// channel number (1-based)
+	int 	column[64];					// position of the channel in a frame
+	int 	gain[64];					// channel gain
+};
+
+// Output files of a .ddt conversion, one per channel. Samples are written
+// as raw int16 (bin) or as "seconds,value" rows (csv).
+struct PlxDdtWriter
+{
+	int 				format;			// PLX_FORMAT_CSV or PLX_FORMAT_BIN
+	double 				frequency;		// frames per second
+	const char 			*baseName;		// output file name prefix
+	int 				numChannels;
+	int 				channel[64];
+	int 				gain[64];
+	FILE 				*files[64];
+	struct PlxOutBuf 	out[64];
+	short 				*columns[64];	// de-interleaved samples (csv)
+	short 				*samples;		// storage of columns
+	int 				frameWidth;
+	int 				column[64];
+	__int64 			numFrames;		// frames written
+	int 				error;
+};
+
+// Reader functions
+int  plxDdtOpen(struct PlxDdtReader *reader, const char *fileName);
+int  plxDdtNext(struct PlxDdtReader *reader, const short **ppFrames, int maxFrames);
+void plxDdtClose(struct PlxDdtReader *reader);
+int  plxDdtFileName(const char *fileName);
+
+// Writer functions
+int  plxDdtWriterOpen(struct PlxDdtWriter *writer, const struct PlxDdtReader *reader, const struct PlxFilter *filter, const char *baseName, int format);
+void plxDdtWriterFrames(struct PlxDdtWriter *writer, const short *frames, int numFrames);
+int  plxDdtWriterClose(struct PlxDdtWriter *writer);
+
+// dst[c][k] = frames[k * frameWidth + c] for every column c with dst[c]
+// not NULL, vectorized (SSE2/AVX2 chosen at run time)
+void plxDdtDeinterleave(short *const *dst, const short *frames, int numFrames, int frameWidth);
+
+#endif
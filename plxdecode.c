@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxdecode.h"
+#include "plxstats.h"
+
+int plxBatchAlloc(struct PlxBatch *batch, int capacity, int sampleCapacity)
+{
+	memset(batch, 0, sizeof(struct PlxBatch));
+
+	if (capacity < 1) capacity = 1;
+	if (sampleCapacity < PLX_MAX_BLOCK_WORDS) sampleCapacity = PLX_MAX_BLOCK_WORDS;
+
+	batch->capacity       = capacity;
+	batch->sampleCapacity = sampleCapacity;
+
+	batch->type         = (short*) malloc (capacity * sizeof(short));
+	batch->timestamp    = (__int64*) malloc (capacity * sizeof(__int64));
+	batch->channel      = (short*) malloc (capacity * sizeof(short));
+	batch->unit         = (short*) malloc (capacity * sizeof(short));
+	batch->numWaveforms = (short*) malloc (capacity * sizeof(short));
+	batch->numWords     = (short*) malloc (capacity * sizeof(short));
+	batch->sampleStart  = (int*) malloc (capacity * sizeof(int));
+	batch->offset       = (unsigned __int64*) malloc (capacity * sizeof(unsigned __int64));
+	batch->samples      = (short*) malloc (sampleCapacity * sizeof(short));
+
+	if ((batch->type == NULL) || (batch->timestamp == NULL) || (batch->channel == NULL) ||
+		(batch->unit == NULL) || (batch->numWaveforms == NULL) || (batch->numWords == NULL) ||
+		(batch->sampleStart == NULL) || (batch->offset == NULL) || (batch->samples == NULL)) {
+		plxBatchFree(batch);
+		return PLX_ERR_MEMORY;
+	}
+
+	return 0;
+}
+
+void plxBatchFree(struct PlxBatch *batch)
+{
+	free(batch->type);
+	free(batch->timestamp);
+	free(batch->channel);
+	free(batch->unit);
+	free(batch->numWaveforms);
+	free(batch->numWords);
+	free(batch->sampleStart);
+	free(batch->offset);
+	free(batch->samples);
+
+	memset(batch, 0, sizeof(struct PlxBatch));
+}
+
+// Initialize filter to accept every block
+void plxFilterInit(struct PlxFilter *filter)
+{
+	memset(filter, 0, sizeof(struct PlxFilter));
+
+	filter->types       = ~0u;
+	filter->from        = 0;
+	filter->to          = 0x7FFFFFFFFFFFFFFFLL;
+	filter->allChannels = 1;
+	filter->allUnits    = 1;
+}
+
+// Restrict filter to the given channels (call once per channel)
+void plxFilterAddChannel(struct PlxFilter *filter, int channel)
+{
+	unsigned short index = (unsigned short) channel;
+
+	filter->allChannels = 0;
+	filter->channels[index >> 3] |= (unsigned char)(1 << (index & 7));
+	filter->channelFold[(index & 255) >> 5] |= 1u << (index & 31);
+}
+
+// Restrict filter to the given sorted units (call once per unit)
+void plxFilterAddUnit(struct PlxFilter *filter, int unit)
+{
+	unsigned short index = (unsigned short) unit;
+
+	filter->allUnits = 0;
+	filter->units[index >> 3] |= (unsigned char)(1 << (index & 7));
+}
+
+int plxFilterMatch(const struct PlxFilter *filter, const struct PL_DataBlockHeader *header)
+{
+	unsigned short index = (unsigned short) header->Channel;
+	__int64 timestamp;
+
+	if (!(filter->types & PLX_TYPE_BIT(header->Type))) return 0;
+	if (!filter->allChannels && !(filter->channels[index >> 3] & (1 << (index & 7)))) return 0;
+
+	index = (unsigned short) header->Unit;
+	if (!filter->allUnits && !(filter->units[index >> 3] & (1 << (index & 7)))) return 0;
+
+	timestamp = (((__int64)(header->UpperByteOf5ByteTimestamp))<<32) + (__int64)(header->TimeStamp);
+
+	return (timestamp >= filter->from) && (timestamp < filter->to);
+}
+
+void plxDecoderInit(struct PlxDecoder *decoder, struct PlxReader *reader)
+{
+	memset(decoder, 0, sizeof(struct PlxDecoder));
+	decoder->reader = reader;
+}
+
+// Decode the next batch of blocks. Returns the number of decoded blocks,
+// 0 at the end of the file.
+int plxDecoderNext(struct PlxDecoder *decoder, struct PlxBatch *batch)
+{
+	struct PL_DataBlockHeader header;
+	struct PlxStats *stats = plxStatsCurrent();
+	const short *pWaveform;
+	unsigned __int64 offset;
+	int i, words, phase;
+
+	batch->count      = 0;
+	batch->numSamples = 0;
+
+	phase = plxStatsPhase(stats, PLX_PHASE_DECODE);
+
+	while (batch->count < batch->capacity) {
+
+		// take the block left over from the last batch first
+		if (decoder->hasPending) {
+			header    = decoder->pending;
+			pWaveform = decoder->pendingWaveform;
+			offset    = decoder->pendingOffset;
+			decoder->hasPending = 0;
+		} else {
+			offset = decoder->reader->offset;
+			if (!plxReaderNextHeader(decoder->reader, &header)) break;
+			if (stats != NULL) plxStatsBlock(stats, &header);
+
+			// rejected blocks are decided from the header, their waveform is never read
+			if ((decoder->filter != NULL) && !plxFilterMatch(decoder->filter, &header)) {
+				if (!plxReaderSkip(decoder->reader)) break;
+				continue;
+			}
+
+			if (decoder->headersOnly) {
+				if (!plxReaderSkip(decoder->reader)) break;
+				pWaveform = NULL;
+			} else if (!plxReaderPayload(decoder->reader, &pWaveform)) break;
+		}
+
+		words = 0;
+		if (!decoder->headersOnly && (header.NumberOfWaveforms > 0) && (header.NumberOfWordsInWaveform > 0)) {
+			words = header.NumberOfWaveforms * header.NumberOfWordsInWaveform;
+		}
+
+		// keep block for the next batch if its samples don't fit anymore
+		if (batch->numSamples + words > batch->sampleCapacity) {
+			if (batch->count > 0) {
+				decoder->pending         = header;
+				decoder->pendingWaveform = pWaveform;
+				decoder->pendingOffset   = offset;
+				decoder->hasPending      = 1;
+				break;
+			}
+			// a single oversized block is truncated
+			words = batch->sampleCapacity;
+		}
+
+		i = batch->count++;
+
+		batch->type[i]         = header.Type;
+		batch->timestamp[i]    = (((__int64)(header.UpperByteOf5ByteTimestamp))<<32) + (__int64)(header.TimeStamp);
+		batch->channel[i]      = header.Channel;
+		batch->unit[i]         = header.Unit;
+		batch->numWaveforms[i] = header.NumberOfWaveforms;
+		batch->numWords[i]     = header.NumberOfWordsInWaveform;
+		batch->sampleStart[i]  = batch->numSamples;
+		batch->offset[i]       = offset;
+
+		if (words > 0) memcpy(&batch->samples[batch->numSamples], pWaveform, words * sizeof(short));
+		batch->numSamples += words;
+	}
+
+	plxStatsProgress(stats, decoder->reader->offset);
+	plxStatsPhase(stats, phase);
+
+	return batch->count;
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXDECODE_H__
+#define __PLXDECODE_H__
+
+#pragma once
+#include "plxreader.h"
+
+// Default batch dimensions
+#define PLX_BATCH_BLOCKS		4096		// blocks per batch
+#define PLX_MAX_BLOCK_WORDS		32767		// largest single waveform (NumberOfWordsInWaveform is a short)
+
+// A batch of decoded data blocks in structure-of-arrays layout. The arrays
+// are allocated once (plxBatchAlloc or by the caller) and reused for every
+// call of plxDecoderNext(), so steady-state decoding does not allocate.
+// Waveform samples of all blocks are stored back to back in samples; block
+// i owns numWaveforms[i] * numWords[i] shorts starting at sampleStart[i].
+struct PlxBatch
+{
+	int 	capacity;					// number of blocks the arrays can hold
+	int 	sampleCapacity;				// number of shorts samples can hold
+	int 	count;						// number of blocks in this batch
+	int 	numSamples;					// number of shorts used in samples
+
+	short 				*type;			// 1=spike, 4=Event, 5=continuous
+	__int64 			*timestamp;		// 40 bit timestamp in ticks
+	short 				*channel;		// channel number
+	short 				*unit;			// sorted unit number
+	short 				*numWaveforms;	// number of waveforms in the block
+	short 				*numWords;		// number of samples per waveform
+	int 				*sampleStart;	// index of the first sample in samples
+	unsigned __int64 	*offset;		// file offset of the data block header
+	short 				*samples;		// waveform samples
+};
+
+// Filter bit of a block type (1=spike, 4=Event, 5=continuous)
+#define PLX_TYPE_BIT(type)		(1u << ((type) & 31))
+
+// Block filter, decided from the data block header alone
+struct PlxFilter
+{
+	unsigned int 	types;					// one bit per accepted block type (PLX_TYPE_BIT)
+	__int64 		from;					// first timestamp in ticks
+	__int64 		to;						// end of the time window in ticks (exclusive)
+	int 			allChannels;			// accept every channel
+	unsigned char 	channels[8192];			// one bit per channel number
+	unsigned int 	channelFold[8];			// channel bits folded to 256 (channel & 255)
+	int 			allUnits;				// accept every unit
+	unsigned char 	units[8192];			// one bit per unit number
+};
+
+// Iterator over the data blocks of a reader
+struct PlxDecoder
+{
+	struct PlxReader 			*reader;
+	const struct PlxFilter 		*filter;			// NULL to decode every block
+	int 						headersOnly;		// skip the waveforms, batches carry no samples
+	struct PL_DataBlockHeader 	pending;			// block that did not fit into the last batch
+	const short 				*pendingWaveform;
+	unsigned __int64 			pendingOffset;
+	int 						hasPending;
+};
+
+// Batch functions
+int  plxBatchAlloc(struct PlxBatch *batch, int capacity, int sampleCapacity);
+void plxBatchFree(struct PlxBatch *batch);
+
+// Filter functions
+void plxFilterInit(struct PlxFilter *filter);
+void plxFilterAddChannel(struct PlxFilter *filter, int channel);
+void plxFilterAddUnit(struct PlxFilter *filter, int unit);
+int  plxFilterMatch(const struct PlxFilter *filter, const struct PL_DataBlockHeader *header);
+
+// Decoder functions
+void plxDecoderInit(struct PlxDecoder *decoder, struct PlxReader *reader);
+int  plxDecoderNext(struct PlxDecoder *decoder, struct PlxBatch *batch);
+
+#endif
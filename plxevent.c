@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxevent.h"
+
+// Unknown channels get an empty name
+static const struct PlxEventName plxEventNoName = { "", 0 };
+
+// Escape name (at most 32 characters, not always terminated) as CSV field
+static void plxEventEscape(struct PlxEventName *entry, const char *name)
+{
+	char *p = entry->field;
+	int i, quote = 0;
+
+	for (i = 0; (i < 32) && (name[i] != '\0'); i++) {
+		if ((name[i] == ',') || (name[i] == '"') || (name[i] == '\n') || (name[i] == '\r')) quote = 1;
+	}
+
+	if (quote) *p++ = '"';
+	for (i = 0; (i < 32) && (name[i] != '\0'); i++) {
+		if (name[i] == '"') *p++ = '"';
+		*p++ = name[i];
+	}
+	if (quote) *p++ = '"';
+
+	*p = '\0';
+	entry->length = (int)(p - entry->field);
+}
+
+int plxEventTableInit(struct PlxEventTable *table, const struct PlxReader *reader)
+{
+	int i, channel, numEvents = reader->fileHeader.NumEventChannels;
+
+	memset(table, 0, sizeof(struct PlxEventTable));
+
+	table->maxChannel = -1;
+	for (i = 0; i < numEvents; i++) {
+		if (reader->eventHeaders[i].Channel > table->maxChannel) table->maxChannel = reader->eventHeaders[i].Channel;
+	}
+
+	table->names = (struct PlxEventName*) calloc (table->maxChannel + 2, sizeof(struct PlxEventName));
+	if (table->names == NULL) return PLX_ERR_MEMORY;
+
+	for (i = 0; i < numEvents; i++) {
+		channel = reader->eventHeaders[i].Channel;
+		if (channel >= 0) plxEventEscape(&table->names[channel], reader->eventHeaders[i].Name);
+	}
+
+	return 0;
+}
+
+const struct PlxEventName *plxEventTableGet(const struct PlxEventTable *table, int channel)
+{
+	if ((channel < 0) || (channel > table->maxChannel)) return &plxEventNoName;
+
+	return &table->names[channel];
+}
+
+void plxEventTableFree(struct PlxEventTable *table)
+{
+	free(table->names);
+	memset(table, 0, sizeof(struct PlxEventTable));
+}
+
+// Event blocks carry no waveform; the strobe value is stored in Unit
+void plxFormatEventRow(struct PlxOutBuf *out, const struct PlxBatch *batch, int index, int frequency, const struct PlxEventTable *table)
+{
+	const struct PlxEventName *name = plxEventTableGet(table, batch->channel[index]);
+	char *p;
+
+	// longest fields: seconds 330 (printf fallback), shorts 7 characters each
+	p = plxOutBufReserve(out, 352 + PLX_EVENT_FIELD_SIZE);
+	if (p == NULL) return;
+
+	p = plxFormatSeconds(p, batch->timestamp[index], frequency);
+	*p++ = ',';
+	p = plxFormatInt(p, batch->channel[index]);
+	*p++ = ',';
+	p = plxFormatInt(p, batch->unit[index]);
+	*p++ = ',';
+	memcpy(p, name->field, name->length);
+	p += name->length;
+	*p++ = '\n';
+
+	out->used = p - out->data;
+}
@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXEVENT_H__
+#define __PLXEVENT_H__
+
+#pragma once
+#include "plxformat.h"
+
+// Room for a CSV field made from a 32 character name (quoted, quotes doubled)
+#define PLX_EVENT_FIELD_SIZE	72
+
+// Event name of one event channel, escaped as CSV field
+struct PlxEventName
+{
+	char 	field[PLX_EVENT_FIELD_SIZE];
+	int 	length;
+};
+
+// Event channel number -> name lookup, built once from the event headers
+// so rows can copy the name without looking at the headers again.
+struct PlxEventTable
+{
+	struct PlxEventName 	*names;			// indexed by channel number, empty if unknown
+	int 					maxChannel;
+};
+
+// Event table functions
+int  plxEventTableInit(struct PlxEventTable *table, const struct PlxReader *reader);
+const struct PlxEventName *plxEventTableGet(const struct PlxEventTable *table, int channel);
+void plxEventTableFree(struct PlxEventTable *table);
+
+// Format one event block as "seconds,event,strobe,name"
+void plxFormatEventRow(struct PlxOutBuf *out, const struct PlxBatch *batch, int index, int frequency, const struct PlxEventTable *table);
+
+#endif
@@ -0,0 +1,600 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PLX_FEATURES_X86
+#endif
+
+#include "plxfeatures.h"
+
+static void plxFeaturesScanGeneric(const short *samples, int count, struct PlxFeatureScan *scan)
+{
+	int i;
+
+	scan->peak        = samples[0];
+	scan->peakIndex   = 0;
+	scan->trough      = samples[0];
+	scan->troughIndex = 0;
+	scan->energy      = 0;
+
+	for (i = 0; i < count; i++) {
+		if (samples[i] > scan->peak) {
+			scan->peak      = samples[i];
+			scan->peakIndex = i;
+		}
+		if (samples[i] < scan->trough) {
+			scan->trough      = samples[i];
+			scan->troughIndex = i;
+		}
+		scan->energy += (unsigned int)(samples[i] * samples[i]);
+	}
+}
+
+// Project samples (zero padded to the component length) on the components
+static void plxFeaturesProjectGeneric(float *pcs, const short *samples, int count, const float *components, int numPcs, int numPoints)
+{
+	int i, k;
+
+	for (k = 0; k < numPcs; k++) {
+		pcs[k] = 0;
+		for (i = 0; i < count; i++) pcs[k] += samples[i] * components[k * numPoints + i];
+	}
+}
+
+#ifdef PLX_FEATURES_X86
+
+// Extremes are reduced over the lanes first, their first index is then
+// found by comparing whole vectors. Squares are summed in pairs by madd;
+// a pair sum is at most 2^31 and fits unsigned 32 bit lanes, which are
+// widened to 64 bit before adding up.
+__attribute__((target("sse2")))
+static void plxFeaturesScanSSE2(const short *samples, int count, struct PlxFeatureScan *scan)
+{
+	__m128i vmax = _mm_set1_epi16(-32768), vmin = _mm_set1_epi16(32767);
+	__m128i vsum = _mm_setzero_si128(), zero = _mm_setzero_si128(), v, sq;
+	unsigned __int64 lanes[2];
+	int i, mask, peak, trough;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		v    = _mm_loadu_si128((const __m128i*)(samples + i));
+		vmax = _mm_max_epi16(vmax, v);
+		vmin = _mm_min_epi16(vmin, v);
+		sq   = _mm_madd_epi16(v, v);
+		vsum = _mm_add_epi64(vsum, _mm_unpacklo_epi32(sq, zero));
+		vsum = _mm_add_epi64(vsum, _mm_unpackhi_epi32(sq, zero));
+	}
+
+	vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 8));
+	vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 4));
+	vmax = _mm_max_epi16(vmax, _mm_srli_si128(vmax, 2));
+	vmin = _mm_min_epi16(vmin, _mm_srli_si128(vmin, 8));
+	vmin = _mm_min_epi16(vmin, _mm_srli_si128(vmin, 4));
+	vmin = _mm_min_epi16(vmin, _mm_srli_si128(vmin, 2));
+
+	peak   = (short) _mm_extract_epi16(vmax, 0);
+	trough = (short) _mm_extract_epi16(vmin, 0);
+
+	_mm_storeu_si128((__m128i*) lanes, vsum);
+	scan->energy = lanes[0] + lanes[1];
+
+	for (; i < count; i++) {
+		if (samples[i] > peak) peak = samples[i];
+		if (samples[i] < trough) trough = samples[i];
+		scan->energy += (unsigned int)(samples[i] * samples[i]);
+	}
+
+	scan->peak        = peak;
+	scan->trough      = trough;
+	scan->peakIndex   = -1;
+	scan->troughIndex = -1;
+
+	vmax = _mm_set1_epi16((short) peak);
+	vmin = _mm_set1_epi16((short) trough);
+
+	for (i = 0; (i + 8 <= count) && ((scan->peakIndex < 0) || (scan->troughIndex < 0)); i += 8) {
+		v = _mm_loadu_si128((const __m128i*)(samples + i));
+		if ((scan->peakIndex < 0) && ((mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, vmax))) != 0)) scan->peakIndex = i + (__builtin_ctz(mask) >> 1);
+		if ((scan->troughIndex < 0) && ((mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, vmin))) != 0)) scan->troughIndex = i + (__builtin_ctz(mask) >> 1);
+	}
+	for (; i < count; i++) {
+		if ((scan->peakIndex < 0) && (samples[i] == peak)) scan->peakIndex = i;
+		if ((scan->troughIndex < 0) && (samples[i] == trough)) scan->troughIndex = i;
+	}
+}
+
+__attribute__((target("avx2")))
+static void plxFeaturesScanAVX2(const short *samples, int count, struct PlxFeatureScan *scan)
+{
+	__m256i vmax = _mm256_set1_epi16(-32768), vmin = _mm256_set1_epi16(32767);
+	__m256i vsum = _mm256_setzero_si256(), zero = _mm256_setzero_si256(), v, sq;
+	__m128i hmax, hmin;
+	unsigned __int64 lanes[4];
+	int i, mask, peak, trough;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		v    = _mm256_loadu_si256((const __m256i*)(samples + i));
+		vmax = _mm256_max_epi16(vmax, v);
+		vmin = _mm256_min_epi16(vmin, v);
+		sq   = _mm256_madd_epi16(v, v);
+		vsum = _mm256_add_epi64(vsum, _mm256_unpacklo_epi32(sq, zero));
+		vsum = _mm256_add_epi64(vsum, _mm256_unpackhi_epi32(sq, zero));
+	}
+
+	hmax = _mm_max_epi16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+	hmax = _mm_max_epi16(hmax, _mm_srli_si128(hmax, 8));
+	hmax = _mm_max_epi16(hmax, _mm_srli_si128(hmax, 4));
+	hmax = _mm_max_epi16(hmax, _mm_srli_si128(hmax, 2));
+	hmin = _mm_min_epi16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+	hmin = _mm_min_epi16(hmin, _mm_srli_si128(hmin, 8));
+	hmin = _mm_min_epi16(hmin, _mm_srli_si128(hmin, 4));
+	hmin = _mm_min_epi16(hmin, _mm_srli_si128(hmin, 2));
+
+	peak   = (short) _mm_extract_epi16(hmax, 0);
+	trough = (short) _mm_extract_epi16(hmin, 0);
+
+	_mm256_storeu_si256((__m256i*) lanes, vsum);
+	scan->energy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+	for (; i < count; i++) {
+		if (samples[i] > peak) peak = samples[i];
+		if (samples[i] < trough) trough = samples[i];
+		scan->energy += (unsigned int)(samples[i] * samples[i]);
+	}
+
+	scan->peak        = peak;
+	scan->trough      = trough;
+	scan->peakIndex   = -1;
+	scan->troughIndex = -1;
+
+	vmax = _mm256_set1_epi16((short) peak);
+	vmin = _mm256_set1_epi16((short) trough);
+
+	for (i = 0; (i + 16 <= count) && ((scan->peakIndex < 0) || (scan->troughIndex < 0)); i += 16) {
+		v = _mm256_loadu_si256((const __m256i*)(samples + i));
+		if ((scan->peakIndex < 0) && ((mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, vmax))) != 0)) scan->peakIndex = i + (__builtin_ctz(mask) >> 1);
+		if ((scan->troughIndex < 0) && ((mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, vmin))) != 0)) scan->troughIndex = i + (__builtin_ctz(mask) >> 1);
+	}
+	for (; i < count; i++) {
+		if ((scan->peakIndex < 0) && (samples[i] == peak)) scan->peakIndex = i;
+		if ((scan->troughIndex < 0) && (samples[i] == trough)) scan->troughIndex = i;
+	}
+}
+
+// Samples are widened to float 8 at a time and multiplied into one
+// accumulator per component
+__attribute__((target("avx2")))
+static void plxFeaturesProjectAVX2(float *pcs, const short *samples, int count, const float *components, int numPcs, int numPoints)
+{
+	__m256 acc[PLX_FEATURES_MAX_PCS], x;
+	__m128 h;
+	int i, k;
+
+	for (k = 0; k < numPcs; k++) acc[k] = _mm256_setzero_ps();
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples + i))));
+		for (k = 0; k < numPcs; k++) {
+			acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(x, _mm256_loadu_ps(components + k * numPoints + i)));
+		}
+	}
+
+	for (k = 0; k < numPcs; k++) {
+		h = _mm_add_ps(_mm256_castps256_ps128(acc[k]), _mm256_extractf128_ps(acc[k], 1));
+		h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+		h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+		pcs[k] = _mm_cvtss_f32(h);
+	}
+
+	for (; i < count; i++) {
+		for (k = 0; k < numPcs; k++) pcs[k] += samples[i] * components[k * numPoints + i];
+	}
+}
+
+#endif
+
+void plxFeaturesScan(const short *samples, int count, struct PlxFeatureScan *scan)
+{
+	if (count <= 0) {
+		memset(scan, 0, sizeof(struct PlxFeatureScan));
+		return;
+	}
+
+#ifdef PLX_FEATURES_X86
+	// the cpu features are detected once at startup by libgcc
+	if (__builtin_cpu_supports("avx2")) {
+		plxFeaturesScanAVX2(samples, count, scan);
+	} else if (__builtin_cpu_supports("sse2")) {
+		plxFeaturesScanSSE2(samples, count, scan);
+	} else {
+		plxFeaturesScanGeneric(samples, count, scan);
+	}
+#else
+	plxFeaturesScanGeneric(samples, count, scan);
+#endif
+}
+
+static void plxFeaturesProject(float *pcs, const short *samples, int count, const float *components, int numPcs, int numPoints)
+{
+#ifdef PLX_FEATURES_X86
+	if (__builtin_cpu_supports("avx2")) {
+		plxFeaturesProjectAVX2(pcs, samples, count, components, numPcs, numPoints);
+		return;
+	}
+#endif
+	plxFeaturesProjectGeneric(pcs, samples, count, components, numPcs, numPoints);
+}
+
+// Open the column files. With presize the rows are sized from the spike
+// counters of the file header.
+int plxFeaturesOpen(struct PlxFeatureWriter *writer, const struct PlxReader *reader, const char *baseName, int presize, int numPcs, const struct PlxScaleTable *scale)
+{
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	__int64 expectedRows = presize ? plxNpySpikeTotal(fileHeader) : 0;
+
+	memset(writer, 0, sizeof(struct PlxFeatureWriter));
+	writer->scale     = scale;
+	writer->baseName  = baseName;
+	writer->numPoints = (fileHeader->NumPointsWave > 0) ? fileHeader->NumPointsWave : 1;
+	writer->numPcs    = (numPcs < PLX_FEATURES_MAX_PCS) ? numPcs : PLX_FEATURES_MAX_PCS;
+	writer->hasBasis  = (writer->numPcs <= 0);
+
+	if (!writer->hasBasis) {
+		writer->mean              = (float*) calloc (writer->numPoints, sizeof(float));
+		writer->components        = (float*) calloc (writer->numPcs * writer->numPoints, sizeof(float));
+		writer->pendingTimestamps = (__int64*) malloc (PLX_FEATURES_PCA_SPIKES * sizeof(__int64));
+		writer->pendingChannel    = (short*) malloc (PLX_FEATURES_PCA_SPIKES * sizeof(short));
+		writer->pendingUnit       = (short*) malloc (PLX_FEATURES_PCA_SPIKES * sizeof(short));
+		writer->pendingScans      = (struct PlxFeatureScan*) malloc (PLX_FEATURES_PCA_SPIKES * sizeof(struct PlxFeatureScan));
+		writer->pendingWaveforms  = (short*) malloc ((size_t) PLX_FEATURES_PCA_SPIKES * writer->numPoints * sizeof(short));
+
+		if ((writer->mean == NULL) || (writer->components == NULL) || (writer->pendingTimestamps == NULL) || (writer->pendingChannel == NULL) ||
+			(writer->pendingUnit == NULL) || (writer->pendingScans == NULL) || (writer->pendingWaveforms == NULL)) {
+			plxFeaturesClose(writer);
+			return PLX_ERR_MEMORY;
+		}
+	}
+
+	if ((plxNpyOpenIds(&writer->timestamps, &writer->channel, &writer->unit, baseName, expectedRows) != 0) ||
+		(plxNpyColumnOpen(&writer->amplitude, baseName, "features.amplitude", (scale != NULL) ? "<f4" : "<i2", 2,
+			(scale != NULL) ? sizeof(float) : sizeof(short), expectedRows) != 0) ||
+		(plxNpyColumnOpen(&writer->index, baseName, "features.index", "<u2", PLX_FEATURES_INDEX, sizeof(unsigned short), expectedRows) != 0) ||
+		(plxNpyColumnOpen(&writer->energy, baseName, "features.energy", "<f4", 0, sizeof(float), expectedRows) != 0) ||
+		((writer->numPcs > 0) && (plxNpyColumnOpen(&writer->pcs, baseName, "features.pcs", "<f4", writer->numPcs, sizeof(float), expectedRows) != 0))) {
+		plxFeaturesClose(writer);
+		return PLX_ERR_OPEN;
+	}
+
+	return 0;
+}
+
+// Eigenvectors of the symmetric n x n matrix a (destroyed, its diagonal
+// ends up holding the eigenvalues) into the columns of v by cyclic Jacobi
+// rotations
+static void plxFeaturesJacobi(double *a, double *v, int n)
+{
+	double off, apq, theta, t, c, s, x, y;
+	int sweep, p, q, k;
+
+	for (p = 0; p < n; p++) {
+		for (q = 0; q < n; q++) v[p * n + q] = (p == q) ? 1.0 : 0.0;
+	}
+
+	for (sweep = 0; sweep < 64; sweep++) {
+
+		off = 0;
+		for (p = 0; p < n; p++) {
+			for (q = p + 1; q < n; q++) off += a[p * n + q] * a[p * n + q];
+		}
+		if (off < 1e-22) break;
+
+		for (p = 0; p < n; p++) {
+			for (q = p + 1; q < n; q++) {
+
+				apq = a[p * n + q];
+				if (fabs(apq) < 1e-300) continue;
+
+				// rotation that zeroes a[p][q]
+				theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+				t = ((theta >= 0) ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+				c = 1.0 / sqrt(t * t + 1.0);
+				s = t * c;
+
+				for (k = 0; k < n; k++) {
+					x = a[k * n + p];
+					y = a[k * n + q];
+					a[k * n + p] = c * x - s * y;
+					a[k * n + q] = s * x + c * y;
+				}
+				for (k = 0; k < n; k++) {
+					x = a[p * n + k];
+					y = a[q * n + k];
+					a[p * n + k] = c * x - s * y;
+					a[q * n + k] = s * x + c * y;
+				}
+				for (k = 0; k < n; k++) {
+					x = v[k * n + p];
+					y = v[k * n + q];
+					v[k * n + p] = c * x - s * y;
+					v[k * n + q] = s * x + c * y;
+				}
+			}
+		}
+	}
+}
+
+// Mean and leading principal components of the pending waveforms. Each
+// component is signed so that its largest coefficient is positive.
+static int plxFeaturesBasis(struct PlxFeatureWriter *writer)
+{
+	int n = writer->numPoints, m = writer->numPending;
+	double *cov, *vectors, *mean, value, largest;
+	const short *w;
+	int i, j, k, s, best, *used;
+
+	cov     = (double*) calloc ((size_t) n * n, sizeof(double));
+	vectors = (double*) calloc ((size_t) n * n, sizeof(double));
+	mean    = (double*) calloc (n, sizeof(double));
+	used    = (int*) calloc (n, sizeof(int));
+
+	if ((cov == NULL) || (vectors == NULL) || (mean == NULL) || (used == NULL)) {
+		free(cov);
+		free(vectors);
+		free(mean);
+		free(used);
+		return PLX_ERR_MEMORY;
+	}
+
+	for (s = 0; s < m; s++) {
+		w = &writer->pendingWaveforms[(size_t) s * n];
+		for (i = 0; i < n; i++) mean[i] += w[i];
+	}
+	for (i = 0; i < n; i++) mean[i] /= (m > 0) ? m : 1;
+
+	for (s = 0; s < m; s++) {
+		w = &writer->pendingWaveforms[(size_t) s * n];
+		for (i = 0; i < n; i++) {
+			value = w[i] - mean[i];
+			for (j = i; j < n; j++) cov[i * n + j] += value * (w[j] - mean[j]);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		for (j = i; j < n; j++) {
+			cov[i * n + j] /= (m > 1) ? m - 1 : 1;
+			cov[j * n + i]  = cov[i * n + j];
+		}
+	}
+
+	plxFeaturesJacobi(cov, vectors, n);
+
+	// components by decreasing eigenvalue
+	for (k = 0; k < writer->numPcs; k++) {
+
+		// no spread to estimate from fewer than two spikes
+		best = -1;
+		for (i = 0; (i < n) && (m > 1); i++) {
+			if (!used[i] && ((best < 0) || (cov[i * n + i] > cov[best * n + best]))) best = i;
+		}
+
+		if (best < 0) {
+			memset(&writer->components[k * n], 0, n * sizeof(float));
+			writer->offsets[k] = 0;
+			continue;
+		}
+		used[best] = 1;
+
+		largest = 0;
+		for (i = 0; i < n; i++) {
+			if (fabs(vectors[i * n + best]) > fabs(largest)) largest = vectors[i * n + best];
+		}
+
+		value = 0;
+		for (i = 0; i < n; i++) {
+			writer->components[k * n + i] = (float)((largest < 0) ? -vectors[i * n + best] : vectors[i * n + best]);
+			value += mean[i] * writer->components[k * n + i];
+		}
+		writer->offsets[k] = (float) value;
+	}
+
+	for (i = 0; i < n; i++) writer->mean[i] = (float) mean[i];
+	writer->hasBasis = 1;
+
+	free(cov);
+	free(vectors);
+	free(mean);
+	free(used);
+
+	return 0;
+}
+
+// Append one row; samples holds count samples of the first waveform
+static void plxFeaturesRow(struct PlxFeatureWriter *writer, __int64 timestamp, short channel, short unit, const struct PlxFeatureScan *scan, const short *samples, int count)
+{
+	__int64 *pTimestamp;
+	short *pChannel, *pUnit;
+	char *pAmplitude;
+	unsigned short *pIndex;
+	float *pEnergy, *pPcs = NULL, scale;
+	int k;
+
+	pTimestamp = (__int64*) plxOutBufReserve(&writer->timestamps.out, sizeof(__int64));
+	pChannel   = (short*) plxOutBufReserve(&writer->channel.out, sizeof(short));
+	pUnit      = (short*) plxOutBufReserve(&writer->unit.out, sizeof(short));
+	pAmplitude = plxOutBufReserve(&writer->amplitude.out, writer->amplitude.rowBytes);
+	pIndex     = (unsigned short*) plxOutBufReserve(&writer->index.out, writer->index.rowBytes);
+	pEnergy    = (float*) plxOutBufReserve(&writer->energy.out, sizeof(float));
+	if (writer->numPcs > 0) pPcs = (float*) plxOutBufReserve(&writer->pcs.out, writer->pcs.rowBytes);
+
+	if ((pTimestamp == NULL) || (pChannel == NULL) || (pUnit == NULL) || (pAmplitude == NULL) || (pIndex == NULL) ||
+		(pEnergy == NULL) || ((writer->numPcs > 0) && (pPcs == NULL))) {
+		writer->error = 1;
+		return;
+	}
+
+	*pTimestamp = timestamp;
+	*pChannel   = channel;
+	*pUnit      = unit;
+
+	if (writer->scale != NULL) {
+		scale = plxScaleGet(writer->scale, channel);
+		((float*) pAmplitude)[0] = scan->peak * scale;
+		((float*) pAmplitude)[1] = scan->trough * scale;
+		*pEnergy = (float)((double) scan->energy * scale * scale);
+	} else {
+		((short*) pAmplitude)[0] = (short) scan->peak;
+		((short*) pAmplitude)[1] = (short) scan->trough;
+		*pEnergy = (float) scan->energy;
+	}
+
+	pIndex[0] = (unsigned short) scan->peakIndex;
+	pIndex[1] = (unsigned short) scan->troughIndex;
+	pIndex[2] = (unsigned short) abs(scan->peakIndex - scan->troughIndex);
+
+	if (writer->numPcs > 0) {
+		if (count > writer->numPoints) count = writer->numPoints;
+		plxFeaturesProject(pPcs, samples, count, writer->components, writer->numPcs, writer->numPoints);
+		for (k = 0; k < writer->numPcs; k++) pPcs[k] -= writer->offsets[k];
+		writer->pcs.out.used += writer->pcs.rowBytes;
+	}
+
+	writer->timestamps.out.used += sizeof(__int64);
+	writer->channel.out.used    += sizeof(short);
+	writer->unit.out.used       += sizeof(short);
+	writer->amplitude.out.used  += writer->amplitude.rowBytes;
+	writer->index.out.used      += writer->index.rowBytes;
+	writer->energy.out.used     += sizeof(float);
+	writer->rows++;
+}
+
+// Estimate the components from the held back spikes and write them
+static void plxFeaturesFlushPending(struct PlxFeatureWriter *writer)
+{
+	int s;
+
+	if (plxFeaturesBasis(writer) != 0) {
+		writer->error = 1;
+		return;
+	}
+
+	for (s = 0; s < writer->numPending; s++) {
+		plxFeaturesRow(writer, writer->pendingTimestamps[s], writer->pendingChannel[s], writer->pendingUnit[s],
+			&writer->pendingScans[s], &writer->pendingWaveforms[(size_t) s * writer->numPoints], writer->numPoints);
+	}
+	writer->numPending = 0;
+}
+
+// Compute the features of the spike blocks of a batch (first waveform of
+// each block)
+void plxFeaturesBatch(struct PlxFeatureWriter *writer, const struct PlxBatch *batch)
+{
+	struct PlxFeatureScan scan;
+	const short *samples;
+	short *pending;
+	int j, words;
+
+	for (j = 0; (j < batch->count) && !writer->error; j++) {
+
+		if (batch->type[j] != 1) continue;
+
+		words = ((batch->numWaveforms[j] > 0) && (batch->numWords[j] > 0)) ? batch->numWords[j] : 0;
+		if (words > batch->numSamples - batch->sampleStart[j]) words = batch->numSamples - batch->sampleStart[j];
+		samples = &batch->samples[batch->sampleStart[j]];
+
+		plxFeaturesScan(samples, words, &scan);
+
+		if (writer->hasBasis) {
+			plxFeaturesRow(writer, batch->timestamp[j], batch->channel[j], batch->unit[j], &scan, samples, words);
+			continue;
+		}
+
+		// hold back (zero padded) until the components are known
+		pending = &writer->pendingWaveforms[(size_t) writer->numPending * writer->numPoints];
+		if (words > writer->numPoints) words = writer->numPoints;
+		memcpy(pending, samples, words * sizeof(short));
+		memset(pending + words, 0, (writer->numPoints - words) * sizeof(short));
+
+		writer->pendingTimestamps[writer->numPending] = batch->timestamp[j];
+		writer->pendingChannel[writer->numPending]    = batch->channel[j];
+		writer->pendingUnit[writer->numPending]       = batch->unit[j];
+		writer->pendingScans[writer->numPending]      = scan;
+
+		if (++writer->numPending == PLX_FEATURES_PCA_SPIKES) plxFeaturesFlushPending(writer);
+	}
+}
+
+// Write the spikes still held back and the components, close the files
+int plxFeaturesClose(struct PlxFeatureWriter *writer)
+{
+	struct PlxNpyColumn basis;
+	char *pRow;
+
+	if (!writer->hasBasis && (writer->timestamps.file != NULL)) plxFeaturesFlushPending(writer);
+
+	if (plxNpyColumnClose(&writer->timestamps, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->channel, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->unit, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->amplitude, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->index, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->energy, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->pcs, writer->rows) != 0) writer->error = 1;
+
+	// mean and components as rows of numPoints values
+	if ((writer->numPcs > 0) && writer->hasBasis && !writer->error) {
+
+		memset(&basis, 0, sizeof(struct PlxNpyColumn));
+
+		if (plxNpyColumnOpen(&basis, writer->baseName, "features.basis", "<f4", writer->numPoints, sizeof(float), writer->numPcs + 1) != 0) {
+			writer->error = 1;
+		} else if ((pRow = plxOutBufReserve(&basis.out, (size_t)(writer->numPcs + 1) * basis.rowBytes)) == NULL) {
+			writer->error = 1;
+		} else {
+			memcpy(pRow, writer->mean, basis.rowBytes);
+			memcpy(pRow + basis.rowBytes, writer->components, (size_t) writer->numPcs * basis.rowBytes);
+			basis.out.used += (size_t)(writer->numPcs + 1) * basis.rowBytes;
+		}
+		if (plxNpyColumnClose(&basis, writer->error ? 0 : writer->numPcs + 1) != 0) writer->error = 1;
+	}
+
+	free(writer->mean);
+	free(writer->components);
+	free(writer->pendingTimestamps);
+	free(writer->pendingChannel);
+	free(writer->pendingUnit);
+	free(writer->pendingScans);
+	free(writer->pendingWaveforms);
+
+	writer->mean              = NULL;
+	writer->components        = NULL;
+	writer->pendingTimestamps = NULL;
+	writer->pendingChannel    = NULL;
+	writer->pendingUnit       = NULL;
+	writer->pendingScans      = NULL;
+	writer->pendingWaveforms  = NULL;
+
+	return writer->error ? -1 : 0;
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXFEATURES_H__
+#define __PLXFEATURES_H__
+
+#pragma once
+#include "plxnpy.h"
+
+// Feature columns
+#define PLX_FEATURES_INDEX		3		// peak index, trough index, width
+#define PLX_FEATURES_MAX_PCS	8		// principal component projections per spike
+#define PLX_FEATURES_PCA_SPIKES	4096	// spikes the principal components are estimated from
+
+// Extremes and energy of one waveform in ADC values
+struct PlxFeatureScan
+{
+	int 				peak;			// largest sample
+	int 				peakIndex;		// first sample with that value
+	int 				trough;			// smallest sample
+	int 				troughIndex;
+	unsigned __int64 	energy;			// sum of squared samples
+};
+
+// Writer for per-spike features instead of waveforms (-features): the
+// timestamps, channel and unit columns of -format bin and per spike
+//   <baseName>.features.amplitude.npy  peak, trough (int16, float32 uV with a scale table)
+//   <baseName>.features.index.npy      peak index, trough index, width in samples (uint16)
+//   <baseName>.features.energy.npy     sum of squared samples (float32)
+//   <baseName>.features.pcs.npy        projections on the first principal components (float32)
+// The components are estimated from the first PLX_FEATURES_PCA_SPIKES
+// spikes of all channels, which are held back until then, and written to
+// <baseName>.features.basis.npy (mean, then one row per component, ADC
+// values).
+struct PlxFeatureWriter
+{
+	struct PlxNpyColumn 	timestamps;
+	struct PlxNpyColumn 	channel;
+	struct PlxNpyColumn 	unit;
+	struct PlxNpyColumn 	amplitude;
+	struct PlxNpyColumn 	index;
+	struct PlxNpyColumn 	energy;
+	struct PlxNpyColumn 	pcs;
+	const struct PlxScaleTable *scale;		// amplitudes in microvolts or NULL for ADC values
+	const char 				*baseName;
+	int 					numPoints;		// waveform samples used for the components (NumPointsWave)
+	int 					numPcs;			// projections per spike
+	int 					hasBasis;		// components are known
+	float 					*mean;			// numPoints
+	float 					*components;	// numPcs x numPoints
+	float 					offsets[PLX_FEATURES_MAX_PCS];	// mean projected on each component
+
+	// spikes held back until the components are known
+	__int64 				*pendingTimestamps;
+	short 					*pendingChannel;
+	short 					*pendingUnit;
+	struct PlxFeatureScan 	*pendingScans;
+	short 					*pendingWaveforms;	// numPoints per spike, zero padded
+	int 					numPending;
+
+	__int64 				rows;			// rows written
+	int 					error;
+};
+
+// Feature functions
+void plxFeaturesScan(const short *samples, int count, struct PlxFeatureScan *scan);
+int  plxFeaturesOpen(struct PlxFeatureWriter *writer, const struct PlxReader *reader, const char *baseName, int presize, int numPcs, const struct PlxScaleTable *scale);
+void plxFeaturesBatch(struct PlxFeatureWriter *writer, const struct PlxBatch *batch);
+int  plxFeaturesClose(struct PlxFeatureWriter *writer);
+
+#endif
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxformat.h"
+#include "plxstats.h"
+
+// Two-digit lookup table for integer conversion
+static const char plxDigits[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+int plxOutBufInit(struct PlxOutBuf *out, FILE *file, size_t size)
+{
+	memset(out, 0, sizeof(struct PlxOutBuf));
+
+	out->file = file;
+	out->size = size;
+	out->data = (char*) malloc (size);
+
+	if (out->data == NULL) {
+		out->size  = 0;
+		out->error = 1;
+		return PLX_ERR_MEMORY;
+	}
+
+	return 0;
+}
+
+// Make room for at least bytes characters and return the write position.
+// Flushes to the output file or grows the buffer when it is in memory.
+char *plxOutBufReserve(struct PlxOutBuf *out, size_t bytes)
+{
+	size_t size;
+	char *data;
+
+	if (out->used + bytes <= out->size) return out->data + out->used;
+
+	if (out->file != NULL) plxOutBufFlush(out);
+
+	if (out->used + bytes > out->size) {
+		size = out->size * 2;
+		if (size < out->used + bytes) size = out->used + bytes;
+
+		data = (char*) realloc (out->data, size);
+		if (data == NULL) {
+			out->error = 1;
+			return NULL;
+		}
+		out->data = data;
+		out->size = size;
+	}
+
+	return out->data + out->used;
+}
+
+void plxOutBufFlush(struct PlxOutBuf *out)
+{
+	struct PlxStats *stats = plxStatsCurrent();
+	int phase;
+
+	if ((out->file == NULL) || (out->used == 0)) return;
+
+	phase = plxStatsPhase(stats, PLX_PHASE_WRITE);
+	if (fwrite(out->data, 1, out->used, out->file) != out->used) out->error = 1;
+	if (stats != NULL) stats->bytesOut += out->used;
+	plxStatsPhase(stats, phase);
+
+	out->bytesWritten += out->used;
+	out->used = 0;
+}
+
+void plxOutBufFree(struct PlxOutBuf *out)
+{
+	plxOutBufFlush(out);
+	free(out->data);
+
+	out->data = NULL;
+	out->size = 0;
+	out->used = 0;
+}
+
+// Write unsigned value (at most 20 digits)
+static char *plxFormatUnsigned(char *p, unsigned __int64 value)
+{
+	char digits[24];
+	char *q = digits + sizeof(digits);
+	unsigned int pair;
+	size_t length;
+
+	while (value >= 100) {
+		pair = (unsigned int)(value % 100) * 2;
+		value /= 100;
+		*--q = plxDigits[pair + 1];
+		*--q = plxDigits[pair];
+	}
+	if (value >= 10) {
+		pair = (unsigned int) value * 2;
+		*--q = plxDigits[pair + 1];
+		*--q = plxDigits[pair];
+	} else {
+		*--q = (char)('0' + value);
+	}
+
+	length = digits + sizeof(digits) - q;
+	memcpy(p, q, length);
+
+	return p + length;
+}
+
+// Same as sprintf("%d")
+char *plxFormatInt(char *p, int value)
+{
+	if (value < 0) {
+		*p++ = '-';
+		return plxFormatUnsigned(p, (unsigned __int64)(-(__int64) value));
+	}
+	return plxFormatUnsigned(p, (unsigned __int64) value);
+}
+
+// Same as sprintf("%.6f", (double) ticks / (double) frequency)
+char *plxFormatSeconds(char *p, __int64 ticks, int frequency)
+{
+	return plxFormatFixed6(p, (double) ticks / (double) frequency);
+}
+
+// Same as sprintf("%.6f", seconds). The value is rounded exactly like
+// printf does, i.e. the exact binary value of the double is rounded half
+// to even to six decimals using 128 bit integers.
+char *plxFormatFixed6(char *p, double seconds)
+{
+	unsigned __int64 bits, mantissa, integral;
+	unsigned __int128 scaled, rest, half;
+	unsigned int fraction;
+	int exponent, i;
+
+	memcpy(&bits, &seconds, sizeof(bits));
+
+	mantissa = bits & ((1ULL << 52) - 1);
+	exponent = (int)((bits >> 52) & 0x7FF);
+
+	// let printf handle negative, infinite and huge values
+	if ((bits >> 63) || (exponent == 0x7FF) || (exponent > 1075 + 10)) {
+		return p + sprintf(p, "%.6f", seconds);
+	}
+
+	if (exponent == 0) {
+		exponent = 1;			// subnormal
+	} else {
+		mantissa |= (1ULL << 52);
+	}
+	exponent -= 1075;			// seconds = mantissa * 2^exponent
+
+	scaled = (unsigned __int128) mantissa * 1000000u;
+
+	if (exponent >= 0) {
+		scaled <<= exponent;
+	} else if (exponent < -100) {
+		scaled = 0;
+	} else {
+		rest   = scaled & ((((unsigned __int128) 1) << -exponent) - 1);
+		half   = ((unsigned __int128) 1) << (-exponent - 1);
+		scaled >>= -exponent;
+		if ((rest > half) || ((rest == half) && (scaled & 1))) scaled++;
+	}
+
+	integral = (unsigned __int64)(scaled / 1000000u);
+	fraction = (unsigned int)(scaled % 1000000u);
+
+	p = plxFormatUnsigned(p, integral);
+	*p++ = '.';
+	for (i = 5; i >= 0; i--) {
+		p[i] = (char)('0' + fraction % 10);
+		fraction /= 10;
+	}
+
+	return p + 6;
+}
+
+// Format one block as "seconds,channel,unit," followed by the waveform
+// samples and a line break if the block carries a single waveform.
+void plxFormatCsvRow(struct PlxOutBuf *out, const struct PlxBatch *batch, int index, int frequency)
+{
+	const short *pWaveform;
+	int i, words = 0;
+	char *p;
+
+	if ((batch->numWaveforms[index] == 1) && (batch->numWords[index] > 0)) {
+		words = batch->numWords[index];
+	}
+
+	// longest fields: seconds 330 (printf fallback), shorts 7 characters each
+	p = plxOutBufReserve(out, 352 + 7 * (size_t) words);
+	if (p == NULL) return;
+
+	p = plxFormatSeconds(p, batch->timestamp[index], frequency);
+	*p++ = ',';
+	p = plxFormatInt(p, batch->channel[index]);
+	*p++ = ',';
+	p = plxFormatInt(p, batch->unit[index]);
+	*p++ = ',';
+
+	if (words > 0) {
+		pWaveform = &batch->samples[batch->sampleStart[index]];
+		for (i = 0; i < words; i++) {
+			p = plxFormatInt(p, pWaveform[i]);
+			*p++ = ',';
+		}
+		p[-1] = '\n';
+	}
+
+	out->used = p - out->data;
+}
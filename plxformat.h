@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXFORMAT_H__
+#define __PLXFORMAT_H__
+
+#pragma once
+#include "plxdecode.h"
+
+// Output formats
+#define PLX_FORMAT_CSV		0
+#define PLX_FORMAT_BIN		1
+
+// Default output buffer size (bytes)
+#define PLX_OUTBUF_SIZE		(4 << 20)
+
+// Output buffer. Rows are formatted straight into data and handed to the
+// output file in large writes. Without a file the buffer grows instead of
+// being flushed, which is used to format data in memory.
+struct PlxOutBuf
+{
+	FILE 	*file;						// output file or NULL
+	char 	*data;						// formatted text
+	size_t 	used;						// bytes used in data
+	size_t 	size;						// capacity of data
+	unsigned __int64 bytesWritten;		// bytes written to file so far
+	int 	error;						// write or allocation failed
+};
+
+// Output buffer functions
+int  plxOutBufInit(struct PlxOutBuf *out, FILE *file, size_t size);
+char *plxOutBufReserve(struct PlxOutBuf *out, size_t bytes);
+void plxOutBufFlush(struct PlxOutBuf *out);
+void plxOutBufFree(struct PlxOutBuf *out);
+
+// Number formatting; each function writes to p and returns the new end
+char *plxFormatInt(char *p, int value);
+char *plxFormatSeconds(char *p, __int64 ticks, int frequency);
+char *plxFormatFixed6(char *p, double seconds);
+
+// CSV rows
+void plxFormatCsvRow(struct PlxOutBuf *out, const struct PlxBatch *batch, int index, int frequency);
+
+#endif
@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+// plxgen: writes synthetic but valid plx files for benchmarks. Spike
+// trains are Poisson per channel (with a refractory period), waveforms
+// are per unit templates plus noise, events are strobed words and a few
+// TTL channels, and continuous channels are noisy sine waves written in
+// blocks. The file header counters match the data blocks.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Plexon.h"
+
+#define PLX_GEN_FREQUENCY		40000		// timestamp frequency
+#define PLX_GEN_STEP			400			// ticks generated per step (10 ms)
+#define PLX_GEN_SLOW_BLOCK		4000		// ticks per continuous block (100 ms)
+#define PLX_GEN_REFRACTORY		40			// minimum ticks between two spikes of a channel
+#define PLX_GEN_EVENTS			4			// TTL event channels (1..4) besides strobed (257)
+#define PLX_GEN_MAX_RECORDS		65536		// records per step
+
+// Generator settings
+struct PlxGenOptions
+{
+	int 	channels;					// spike channels 1..channels
+	int 	units;						// units 0..units-1 per channel
+	int 	wave;						// samples per waveform
+	double 	duration;					// seconds
+	double 	rate;						// spikes per second and channel
+	double 	events;						// events per second
+	int 	slow;						// continuous channels 0..slow-1
+	int 	slowFreq;					// continuous sampling rate
+	double 	size;					// target file size in MB (overrides duration)
+	unsigned long long seed;
+};
+
+// One data block of a step
+struct PlxGenRecord
+{
+	long long 	timestamp;
+	short 		type;
+	short 		channel;
+	short 		unit;
+};
+
+static unsigned long long plxGenState;
+
+// xorshift64*
+static unsigned long long plxGenRandom(void)
+{
+	plxGenState ^= plxGenState >> 12;
+	plxGenState ^= plxGenState << 25;
+	plxGenState ^= plxGenState >> 27;
+	return plxGenState * 2685821657736338717ULL;
+}
+
+// uniform in (0, 1]
+static double plxGenUniform(void)
+{
+	return ((plxGenRandom() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+// exponential interval in ticks
+static long long plxGenInterval(double rate)
+{
+	return (long long)(-log(plxGenUniform()) / rate * PLX_GEN_FREQUENCY) + 1;
+}
+
+static int plxGenCompare(const void *a, const void *b)
+{
+	const struct PlxGenRecord *ra = (const struct PlxGenRecord*) a;
+	const struct PlxGenRecord *rb = (const struct PlxGenRecord*) b;
+
+	if (ra->timestamp != rb->timestamp) return (ra->timestamp < rb->timestamp) ? -1 : 1;
+	if (ra->type != rb->type) return ra->type - rb->type;
+	return ra->channel - rb->channel;
+}
+
+static void plxGenBlock(FILE *file, const struct PlxGenRecord *record, short numWaveforms, short numWords, const short *samples)
+{
+	struct PL_DataBlockHeader header;
+
+	memset(&header, 0, sizeof(struct PL_DataBlockHeader));
+	header.Type                      = record->type;
+	header.UpperByteOf5ByteTimestamp = (unsigned short)(record->timestamp >> 32);
+	header.TimeStamp                 = (unsigned int) record->timestamp;
+	header.Channel                   = record->channel;
+	header.Unit                      = record->unit;
+	header.NumberOfWaveforms         = numWaveforms;
+	header.NumberOfWordsInWaveform   = numWords;
+
+	fwrite(&header, sizeof(struct PL_DataBlockHeader), 1, file);
+	if (numWaveforms * numWords > 0) fwrite(samples, sizeof(short), numWaveforms * numWords, file);
+}
+
+static void printUsage(void)
+{
+	fprintf(stdout, "\nplxgen - synthetic plx files for plx2csv benchmarks\n"\
+           "Usage: plxgen <outputfile> [options]\n\n"\
+           "Options:\n"\
+           "  -channels N   : spike channels (16)\n"\
+           "  -units N      : units per channel, unit 0 is unsorted (3)\n"\
+           "  -wave N       : samples per spike waveform (32)\n"\
+           "  -rate R       : spikes per second and channel (20)\n"\
+           "  -events R     : events per second (2)\n"\
+           "  -slow N       : continuous channels (4)\n"\
+           "  -slowfreq F   : continuous sampling rate in Hz (1000)\n"\
+           "  -duration S   : recording length in seconds (60)\n"\
+           "  -size MB      : recording length from the file size instead of -duration\n"\
+           "  -seed N       : random seed (1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct PlxGenOptions options;
+	struct PL_FileHeader fileHeader;
+	struct PL_ChanHeader *chanHeaders;
+	struct PL_EventHeader eventHeaders[PLX_GEN_EVENTS + 1];
+	struct PL_SlowChannelHeader *slowHeaders;
+	struct PlxGenRecord *records;
+
+	FILE *file;
+	short *templates, *samples;
+	long long *nextSpike, nextEvent, end, t, ticks;
+	double bytesPerSecond, *phase, *step, x, amplitude;
+	int slowWords, numRecords;
+	int i, j, k, n;
+
+	if (argc < 2) {
+		printUsage();
+		return 1;
+	}
+
+	options.channels = 16;
+	options.units    = 3;
+	options.wave     = 32;
+	options.duration = 60;
+	options.rate     = 20;
+	options.events   = 2;
+	options.slow     = 4;
+	options.slowFreq = 1000;
+	options.size     = 0;
+	options.seed     = 1;
+
+	for (i = 2; i < argc - 1; i++) {
+		if (!strcmp("-channels", argv[i])) options.channels = atoi(argv[++i]);
+		else if (!strcmp("-units", argv[i])) options.units = atoi(argv[++i]);
+		else if (!strcmp("-wave", argv[i])) options.wave = atoi(argv[++i]);
+		else if (!strcmp("-rate", argv[i])) options.rate = atof(argv[++i]);
+		else if (!strcmp("-events", argv[i])) options.events = atof(argv[++i]);
+		else if (!strcmp("-slow", argv[i])) options.slow = atoi(argv[++i]);
+		else if (!strcmp("-slowfreq", argv[i])) options.slowFreq = atoi(argv[++i]);
+		else if (!strcmp("-duration", argv[i])) options.duration = atof(argv[++i]);
+		else if (!strcmp("-size", argv[i])) options.size = atof(argv[++i]);
+		else if (!strcmp("-seed", argv[i])) options.seed = strtoull(argv[++i], NULL, 10);
+	}
+
+	if ((options.channels < 0) || (options.channels > 128) || (options.units < 1) || (options.units > 5) ||
+		(options.wave < 1) || (options.wave > 256) || (options.slow < 0) || (options.slow > 200) ||
+		(options.slowFreq < 1) || (options.slowFreq > PLX_GEN_FREQUENCY) || (options.rate < 0) || (options.events < 0)) {
+		fprintf(stderr, "Error: Invalid options.\n");
+		return 1;
+	}
+
+	// recording length that gives the requested file size
+	slowWords = (int)((long long) options.slowFreq * PLX_GEN_SLOW_BLOCK / PLX_GEN_FREQUENCY);
+	if (options.size > 0) {
+		bytesPerSecond = options.channels * options.rate * (sizeof(struct PL_DataBlockHeader) + options.wave * sizeof(short)) +
+			options.events * sizeof(struct PL_DataBlockHeader) +
+			options.slow * (double) PLX_GEN_FREQUENCY / PLX_GEN_SLOW_BLOCK * (sizeof(struct PL_DataBlockHeader) + slowWords * sizeof(short));
+		if (bytesPerSecond > 0) options.duration = options.size * 1e6 / bytesPerSecond;
+	}
+
+	plxGenState = options.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+	chanHeaders = (struct PL_ChanHeader*) calloc (options.channels + 1, sizeof(struct PL_ChanHeader));
+	slowHeaders = (struct PL_SlowChannelHeader*) calloc (options.slow + 1, sizeof(struct PL_SlowChannelHeader));
+	records     = (struct PlxGenRecord*) malloc (PLX_GEN_MAX_RECORDS * sizeof(struct PlxGenRecord));
+	templates   = (short*) malloc ((options.channels + 1) * 5 * options.wave * sizeof(short));
+	samples     = (short*) malloc ((options.wave + slowWords + 1) * sizeof(short));
+	nextSpike   = (long long*) malloc ((options.channels + 1) * sizeof(long long));
+	phase       = (double*) malloc ((options.slow + 1) * sizeof(double));
+	step        = (double*) malloc ((options.slow + 1) * sizeof(double));
+
+	if ((chanHeaders == NULL) || (slowHeaders == NULL) || (records == NULL) || (templates == NULL) ||
+		(samples == NULL) || (nextSpike == NULL) || (phase == NULL) || (step == NULL)) {
+		fprintf(stderr, "Error: Out of memory.\n");
+		return 1;
+	}
+
+	file = fopen(argv[1], "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Error: Cannot open output file.\n");
+		return 1;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+	// headers
+	memset(&fileHeader, 0, sizeof(struct PL_FileHeader));
+	fileHeader.MagicNumber         = 0x58454C50;
+	fileHeader.Version             = 105;
+	fileHeader.ADFrequency         = PLX_GEN_FREQUENCY;
+	fileHeader.NumDSPChannels      = options.channels;
+	fileHeader.NumEventChannels    = PLX_GEN_EVENTS + 1;
+	fileHeader.NumSlowChannels     = options.slow;
+	fileHeader.NumPointsWave       = options.wave;
+	fileHeader.NumPointsPreThr     = options.wave / 4;
+	fileHeader.Year                = 2011;
+	fileHeader.Month               = 1;
+	fileHeader.Day                 = 1;
+	fileHeader.WaveformFreq        = PLX_GEN_FREQUENCY;
+	fileHeader.Trodalness          = 1;
+	fileHeader.DataTrodalness      = 1;
+	fileHeader.BitsPerSpikeSample  = 12;
+	fileHeader.BitsPerSlowSample   = 12;
+	fileHeader.SpikeMaxMagnitudeMV = 3000;
+	fileHeader.SlowMaxMagnitudeMV  = 5000;
+	fileHeader.SpikePreAmpGain     = 1000;
+	snprintf(fileHeader.Comment, sizeof(fileHeader.Comment), "plxgen seed %llu", options.seed);
+
+	for (i = 0; i < options.channels; i++) {
+		snprintf(chanHeaders[i].Name, sizeof(chanHeaders[i].Name), "sig%03d", i + 1);
+		snprintf(chanHeaders[i].SIGName, sizeof(chanHeaders[i].SIGName), "sig%03d", i + 1);
+		chanHeaders[i].Channel = i + 1;
+		chanHeaders[i].SIG     = i + 1;
+		chanHeaders[i].Gain    = 1 + i % 4;
+		chanHeaders[i].NUnits  = options.units - 1;
+	}
+
+	memset(eventHeaders, 0, sizeof(eventHeaders));
+	for (i = 0; i < PLX_GEN_EVENTS; i++) {
+		snprintf(eventHeaders[i].Name, sizeof(eventHeaders[i].Name), "Event%03d", i + 1);
+		eventHeaders[i].Channel = i + 1;
+	}
+	snprintf(eventHeaders[PLX_GEN_EVENTS].Name, sizeof(eventHeaders[PLX_GEN_EVENTS].Name), "Strobed");
+	eventHeaders[PLX_GEN_EVENTS].Channel = 257;
+
+	for (i = 0; i < options.slow; i++) {
+		snprintf(slowHeaders[i].Name, sizeof(slowHeaders[i].Name), "AD%02d", i + 1);
+		slowHeaders[i].Channel    = i;
+		slowHeaders[i].ADFreq     = options.slowFreq;
+		slowHeaders[i].Gain       = 1;
+		slowHeaders[i].Enabled    = 1;
+		slowHeaders[i].PreAmpGain = 1000;
+	}
+
+	// written again with the counters at the end
+	fwrite(&fileHeader, sizeof(struct PL_FileHeader), 1, file);
+	fwrite(chanHeaders, sizeof(struct PL_ChanHeader), options.channels, file);
+	fwrite(eventHeaders, sizeof(struct PL_EventHeader), PLX_GEN_EVENTS + 1, file);
+	fwrite(slowHeaders, sizeof(struct PL_SlowChannelHeader), options.slow, file);
+
+	// spike templates per channel and unit: trough followed by a smaller peak
+	for (i = 0; i <= options.channels; i++) {
+		for (j = 0; j < 5; j++) {
+			for (k = 0; k < options.wave; k++) {
+				x = (k - fileHeader.NumPointsPreThr) / (options.wave / 32.0 + 0.01);
+				amplitude = (j == 0) ? 150 : 400 + 250 * j + 30 * (i % 7);
+				templates[(i * 5 + j) * options.wave + k] = (short)(-amplitude * exp(-x * x / 4) + 0.4 * amplitude * exp(-(x - 6) * (x - 6) / 18));
+			}
+		}
+	}
+
+	for (i = 1; i <= options.channels; i++) nextSpike[i] = (options.rate > 0) ? plxGenInterval(options.rate) : -1;
+	nextEvent = (options.events > 0) ? plxGenInterval(options.events) : -1;
+
+	for (i = 0; i < options.slow; i++) {
+		phase[i] = 0;
+		step[i]  = 2 * M_PI * (1 + i) / options.slowFreq;
+	}
+
+	end = (long long)(options.duration * PLX_GEN_FREQUENCY);
+
+	for (t = 0; t < end; t += PLX_GEN_STEP) {
+
+		numRecords = 0;
+
+		// continuous blocks at the start of their interval
+		if (t % PLX_GEN_SLOW_BLOCK == 0) {
+			for (i = 0; i < options.slow; i++) {
+				records[numRecords].timestamp = t;
+				records[numRecords].type      = 5;
+				records[numRecords].channel   = (short) i;
+				records[numRecords].unit      = 0;
+				numRecords++;
+			}
+		}
+
+		for (i = 1; i <= options.channels; i++) {
+			while ((nextSpike[i] >= 0) && (nextSpike[i] < t + PLX_GEN_STEP) && (numRecords < PLX_GEN_MAX_RECORDS)) {
+				records[numRecords].timestamp = nextSpike[i];
+				records[numRecords].type      = 1;
+				records[numRecords].channel   = (short) i;
+				records[numRecords].unit      = (short)(plxGenRandom() % options.units);
+				numRecords++;
+				nextSpike[i] += PLX_GEN_REFRACTORY + plxGenInterval(options.rate);
+			}
+		}
+
+		while ((nextEvent >= 0) && (nextEvent < t + PLX_GEN_STEP) && (numRecords < PLX_GEN_MAX_RECORDS)) {
+			n = (int)(plxGenRandom() % (PLX_GEN_EVENTS + 1));
+			records[numRecords].timestamp = nextEvent;
+			records[numRecords].type      = 4;
+			records[numRecords].channel   = (short)((n == PLX_GEN_EVENTS) ? 257 : n + 1);
+			records[numRecords].unit      = (short)((n == PLX_GEN_EVENTS) ? plxGenRandom() % 32768 : 0);
+			numRecords++;
+			nextEvent += plxGenInterval(options.events);
+		}
+
+		qsort(records, numRecords, sizeof(struct PlxGenRecord), plxGenCompare);
+
+		for (j = 0; j < numRecords; j++) {
+
+			if (records[j].type == 1) {
+
+				for (k = 0; k < options.wave; k++) {
+					samples[k] = templates[(records[j].channel * 5 + records[j].unit) * options.wave + k] + (short)(plxGenRandom() % 61) - 30;
+				}
+				plxGenBlock(file, &records[j], 1, (short) options.wave, samples);
+
+				fileHeader.TSCounts[records[j].channel][records[j].unit]++;
+				fileHeader.WFCounts[records[j].channel][records[j].unit]++;
+
+			} else if (records[j].type == 4) {
+
+				plxGenBlock(file, &records[j], 0, 0, NULL);
+				fileHeader.EVCounts[records[j].channel]++;
+
+			} else {
+
+				i = records[j].channel;
+				for (k = 0; k < slowWords; k++) {
+					samples[k] = (short)(1000 * sin(phase[i]) + (short)(plxGenRandom() % 41) - 20);
+					phase[i] += step[i];
+				}
+				plxGenBlock(file, &records[j], 1, (short) slowWords, samples);
+				if (300 + i < 512) fileHeader.EVCounts[300 + i] += slowWords;
+			}
+
+			if (records[j].timestamp > fileHeader.LastTimestamp) fileHeader.LastTimestamp = (double) records[j].timestamp;
+		}
+	}
+
+	// header with the final counters
+	ticks = (long long) fileHeader.LastTimestamp;
+	if ((fseeko(file, 0, SEEK_SET) != 0) || (fwrite(&fileHeader, sizeof(struct PL_FileHeader), 1, file) != 1) || (fclose(file) != 0)) {
+		fprintf(stderr, "Error: Cannot write output file.\n");
+		return 1;
+	}
+
+	fprintf(stdout, "plxgen: %s, %.1f s, %d spike channels, %d continuous channels\n", argv[1], ticks / (double) PLX_GEN_FREQUENCY, options.channels, options.slow);
+
+	free(chanHeaders);
+	free(slowHeaders);
+	free(records);
+	free(templates);
+	free(samples);
+	free(nextSpike);
+	free(phase);
+	free(step);
+
+	return 0;
+}
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxindex.h"
+
+// Append an empty checkpoint at offset
+static struct PlxCheckpoint *plxIndexAppend(struct PlxIndex *index, unsigned __int64 offset)
+{
+	struct PlxCheckpoint *checkpoints, *checkpoint;
+	__int64 capacity;
+
+	if (index->header.numCheckpoints == index->capacity) {
+		capacity = (index->capacity > 0) ? index->capacity * 2 : 1024;
+		checkpoints = (struct PlxCheckpoint*) realloc (index->checkpoints, capacity * sizeof(struct PlxCheckpoint));
+		if (checkpoints == NULL) return NULL;
+
+		index->checkpoints = checkpoints;
+		index->capacity    = capacity;
+	}
+
+	checkpoint = &index->checkpoints[index->header.numCheckpoints++];
+	memset(checkpoint, 0, sizeof(struct PlxCheckpoint));
+
+	checkpoint->offset       = offset;
+	checkpoint->minTimestamp = 0x7FFFFFFFFFFFFFFFLL;
+	checkpoint->maxTimestamp = -1;
+
+	return checkpoint;
+}
+
+// Build index by walking all block headers of the reader, starting at
+// its first data block. Payloads are skipped, not decoded. The reader is
+// positioned at the first data block again afterwards.
+int plxIndexBuild(struct PlxIndex *index, struct PlxReader *reader, unsigned __int64 spacing)
+{
+	struct PL_DataBlockHeader header;
+	struct PlxCheckpoint *checkpoint = NULL;
+	unsigned __int64 offset;
+	unsigned short channel;
+	__int64 timestamp;
+
+	memset(index, 0, sizeof(struct PlxIndex));
+
+	index->header.magic      = PLX_INDEX_MAGIC;
+	index->header.version    = PLX_INDEX_VERSION;
+	index->header.fileSize   = reader->size;
+	index->header.fileTime   = reader->mtime;
+	index->header.dataOffset = reader->dataOffset;
+	index->header.spacing    = spacing;
+
+	if (plxReaderSeek(reader, reader->dataOffset) != 0) return PLX_ERR_INVALID;
+
+	for (;;) {
+
+		offset = reader->offset;
+		if (!plxReaderNextHeader(reader, &header) || !plxReaderSkip(reader)) break;
+
+		// start a new segment every spacing bytes
+		if ((checkpoint == NULL) || (offset - checkpoint->offset >= spacing)) {
+			checkpoint = plxIndexAppend(index, offset);
+			if (checkpoint == NULL) {
+				plxIndexFree(index);
+				return PLX_ERR_MEMORY;
+			}
+		}
+
+		timestamp = (((__int64)(header.UpperByteOf5ByteTimestamp))<<32) + (__int64)(header.TimeStamp);
+		if (timestamp < checkpoint->minTimestamp) checkpoint->minTimestamp = timestamp;
+		if (timestamp > checkpoint->maxTimestamp) checkpoint->maxTimestamp = timestamp;
+
+		channel = (unsigned short) header.Channel;
+		checkpoint->channels[(channel & 255) >> 5] |= 1u << (channel & 31);
+	}
+
+	index->header.dataEnd = reader->offset;
+
+	return plxReaderSeek(reader, reader->dataOffset);
+}
+
+// Load index from file. Fails if the index does not belong to the
+// reader's file (size or modification time differ).
+int plxIndexLoad(struct PlxIndex *index, const char *fileName, const struct PlxReader *reader)
+{
+	FILE *indexFile;
+	__int64 count;
+
+	memset(index, 0, sizeof(struct PlxIndex));
+
+	indexFile = fopen(fileName, "rb");
+	if (indexFile == NULL) return PLX_ERR_OPEN;
+
+	if ((fread(&index->header, sizeof(struct PlxIndexHeader), 1, indexFile) != 1) ||
+		(index->header.magic != PLX_INDEX_MAGIC) ||
+		(index->header.version != PLX_INDEX_VERSION) ||
+		(index->header.fileSize != reader->size) ||
+		(index->header.fileTime != reader->mtime) ||
+		(index->header.dataOffset != reader->dataOffset) ||
+		(index->header.numCheckpoints < 0)) {
+		fclose(indexFile);
+		return PLX_ERR_INVALID;
+	}
+
+	count = index->header.numCheckpoints;
+	index->checkpoints = (struct PlxCheckpoint*) malloc ((count + 1) * sizeof(struct PlxCheckpoint));
+	index->capacity    = count + 1;
+
+	if (index->checkpoints == NULL) {
+		fclose(indexFile);
+		return PLX_ERR_MEMORY;
+	}
+
+	if (fread(index->checkpoints, sizeof(struct PlxCheckpoint), (size_t) count, indexFile) != (size_t) count) {
+		fclose(indexFile);
+		plxIndexFree(index);
+		return PLX_ERR_INVALID;
+	}
+
+	fclose(indexFile);
+	return 0;
+}
+
+int plxIndexSave(const struct PlxIndex *index, const char *fileName)
+{
+	FILE *indexFile;
+	size_t count = (size_t) index->header.numCheckpoints;
+	int result = 0;
+
+	indexFile = fopen(fileName, "wb");
+	if (indexFile == NULL) return PLX_ERR_OPEN;
+
+	if ((fwrite(&index->header, sizeof(struct PlxIndexHeader), 1, indexFile) != 1) ||
+		(fwrite(index->checkpoints, sizeof(struct PlxCheckpoint), count, indexFile) != count)) {
+		result = PLX_ERR_OPEN;
+	}
+
+	if (fclose(indexFile) != 0) result = PLX_ERR_OPEN;
+
+	return result;
+}
+
+// Check whether a segment can contain blocks accepted by filter
+static int plxIndexMatch(const struct PlxCheckpoint *checkpoint, const struct PlxFilter *filter)
+{
+	int i;
+
+	if ((checkpoint->maxTimestamp < filter->from) || (checkpoint->minTimestamp >= filter->to)) return 0;
+	if (filter->allChannels) return 1;
+
+	for (i = 0; i < 8; i++) {
+		if (checkpoint->channels[i] & filter->channelFold[i]) return 1;
+	}
+
+	return 0;
+}
+
+// Get the next byte range [start, end) of consecutive segments that may
+// contain blocks accepted by filter. position is the segment to continue
+// with and must be 0 for the first call. Returns 0 if there are no more.
+int plxIndexNextRange(const struct PlxIndex *index, const struct PlxFilter *filter, __int64 *position, unsigned __int64 *start, unsigned __int64 *end)
+{
+	__int64 i = *position, count = index->header.numCheckpoints;
+
+	while ((i < count) && !plxIndexMatch(&index->checkpoints[i], filter)) i++;
+	if (i >= count) {
+		*position = count;
+		return 0;
+	}
+
+	*start = index->checkpoints[i].offset;
+	while ((i < count) && plxIndexMatch(&index->checkpoints[i], filter)) i++;
+	*end = (i < count) ? index->checkpoints[i].offset : index->header.dataEnd;
+
+	*position = i;
+	return 1;
+}
+
+void plxIndexFree(struct PlxIndex *index)
+{
+	free(index->checkpoints);
+	memset(index, 0, sizeof(struct PlxIndex));
+}
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXINDEX_H__
+#define __PLXINDEX_H__
+
+#pragma once
+#include "plxdecode.h"
+
+#define PLX_INDEX_MAGIC		0x58444950	// "PIDX"
+#define PLX_INDEX_VERSION	1
+#define PLX_INDEX_SPACING	(256 << 10)	// input bytes between checkpoints
+
+// Sidecar index file header
+struct PlxIndexHeader
+{
+	unsigned int 		magic;			// = PLX_INDEX_MAGIC
+	int 				version;		// = PLX_INDEX_VERSION
+	unsigned __int64 	fileSize;		// size of the indexed plx file
+	__int64 			fileTime;		// modification time of the indexed plx file
+	unsigned __int64 	dataOffset;		// offset of the first data block
+	unsigned __int64 	dataEnd;		// offset behind the last complete data block
+	unsigned __int64 	spacing;		// bytes between checkpoints
+	__int64 			numCheckpoints;
+};
+
+// Checkpoint at the start of a segment of consecutive data blocks. The
+// segment ends at the next checkpoint (or dataEnd for the last one).
+struct PlxCheckpoint
+{
+	unsigned __int64 	offset;			// offset of the first block in the segment
+	__int64 			minTimestamp;	// smallest timestamp in the segment
+	__int64 			maxTimestamp;	// largest timestamp in the segment
+	unsigned int 		channels[8];	// bit (channel & 255) set if the segment has blocks of that channel
+};
+
+// Block offset index of a plx file
+struct PlxIndex
+{
+	struct PlxIndexHeader 	header;
+	struct PlxCheckpoint 	*checkpoints;
+	__int64 				capacity;	// allocated checkpoints
+};
+
+// Index functions
+int  plxIndexBuild(struct PlxIndex *index, struct PlxReader *reader, unsigned __int64 spacing);
+int  plxIndexLoad(struct PlxIndex *index, const char *fileName, const struct PlxReader *reader);
+int  plxIndexSave(const struct PlxIndex *index, const char *fileName);
+int  plxIndexNextRange(const struct PlxIndex *index, const struct PlxFilter *filter, __int64 *position, unsigned __int64 *start, unsigned __int64 *end);
+void plxIndexFree(struct PlxIndex *index);
+
+#endif
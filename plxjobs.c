@@ -0,0 +1,302 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "plx2csv.h"
+
+// Jobs of one worker. The owner takes the largest job from the front,
+// idle workers steal from the back.
+struct PlxJobQueue
+{
+	pthread_mutex_t 	mutex;
+	int 				*jobs;			// indices into fileNames, largest first
+	int 				head;
+	int 				tail;
+};
+
+// State shared by the batch workers
+struct PlxJobPool
+{
+	const char 				**fileNames;
+	unsigned __int64 		*sizes;
+	struct PlxReport 		*reports;
+	struct PlxJobQueue 		*queues;
+	int 					numWorkers;
+	const struct PlxOptions *options;
+
+	// input bytes in flight (-budget)
+	pthread_mutex_t 		mutex;
+	pthread_cond_t 			released;
+	unsigned __int64 		budgetUsed;
+	int 					done;
+};
+
+struct PlxJobWorker
+{
+	struct PlxJobPool 	*pool;
+	int 				index;
+};
+
+// File size and index of a job, sorted largest first
+struct PlxJobOrder
+{
+	unsigned __int64 	size;
+	int 				index;
+};
+
+// Pop a job from the own queue or steal one from another worker; -1 if
+// all queues are empty
+static int plxJobNext(struct PlxJobPool *pool, int worker)
+{
+	struct PlxJobQueue *queue;
+	int i, job = -1;
+
+	queue = &pool->queues[worker];
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->head < queue->tail) job = queue->jobs[queue->head++];
+	pthread_mutex_unlock(&queue->mutex);
+
+	for (i = 1; (job < 0) && (i < pool->numWorkers); i++) {
+		queue = &pool->queues[(worker + i) % pool->numWorkers];
+		pthread_mutex_lock(&queue->mutex);
+		if (queue->head < queue->tail) job = queue->jobs[--queue->tail];
+		pthread_mutex_unlock(&queue->mutex);
+	}
+
+	return job;
+}
+
+// Wait until the job fits into the budget. A job larger than the budget
+// runs alone.
+static unsigned __int64 plxJobAcquire(struct PlxJobPool *pool, unsigned __int64 size)
+{
+	unsigned __int64 budget = pool->options->budget;
+
+	if (budget == 0) return 0;
+	if (size > budget) size = budget;
+
+	pthread_mutex_lock(&pool->mutex);
+	while ((pool->budgetUsed > 0) && (pool->budgetUsed + size > budget)) {
+		pthread_cond_wait(&pool->released, &pool->mutex);
+	}
+	pool->budgetUsed += size;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return size;
+}
+
+static void plxJobRelease(struct PlxJobPool *pool, unsigned __int64 size, const struct PlxReport *report)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->budgetUsed -= size;
+	pool->done++;
+	pthread_cond_broadcast(&pool->released);
+	pthread_mutex_unlock(&pool->mutex);
+
+	fprintf(stdout, " [%d] %s %s (%.1f MB, %.3f s)\n", pool->done, report->status ? "FAILED" : "done",
+		report->fileName, report->size / 1e6, report->elapsed);
+}
+
+static void *plxJobWorker(void *arg)
+{
+	struct PlxJobWorker *worker = (struct PlxJobWorker*) arg;
+	struct PlxJobPool *pool = worker->pool;
+	unsigned __int64 acquired;
+	int job;
+
+	while ((job = plxJobNext(pool, worker->index)) >= 0) {
+
+		acquired = plxJobAcquire(pool, pool->sizes[job]);
+		convertFile(pool->fileNames[job], pool->options, &pool->reports[job]);
+		plxJobRelease(pool, acquired, &pool->reports[job]);
+	}
+
+	return NULL;
+}
+
+// Order jobs by file size, largest first
+static int plxJobCompare(const void *a, const void *b)
+{
+	const struct PlxJobOrder *jobA = (const struct PlxJobOrder*) a;
+	const struct PlxJobOrder *jobB = (const struct PlxJobOrder*) b;
+
+	if (jobA->size != jobB->size) return (jobA->size > jobB->size) ? -1 : 1;
+	return jobA->index - jobB->index;
+}
+
+// Write a quoted CSV field, embedded quotes are doubled (RFC 4180)
+static void plxJobQuoted(FILE *file, const char *text)
+{
+	fputc('"', file);
+	for (; *text != '\0'; text++) {
+		if (*text == '"') fputc('"', file);
+		fputc(*text, file);
+	}
+	fputc('"', file);
+}
+
+// Write one line per file and the totals of the batch
+static int plxJobReport(const struct PlxJobPool *pool, int numFiles, const char *reportFileName, double elapsed)
+{
+	const struct PlxReport *report;
+	unsigned __int64 bytes = 0;
+	FILE *reportFile;
+	int i, failed = 0;
+
+	reportFile = fopen(reportFileName, "w");
+	if (reportFile != NULL) fprintf(reportFile, "File,Status,Size,Spikes,Events,Continuous,Truncated,Seconds,Error\n");
+
+	for (i = 0; i < numFiles; i++) {
+
+		report = &pool->reports[i];
+		if (report->status != 0) failed++;
+		bytes += report->size;
+
+		if (reportFile != NULL) {
+			plxJobQuoted(reportFile, report->fileName);
+			fprintf(reportFile, ",%s,%llu,%d,%d,%d,%d,%.3f,", report->status ? "failed" : "ok",
+				pool->sizes[i], report->counts.spikes, report->counts.events, report->counts.slow, report->truncated,
+				report->elapsed);
+			plxJobQuoted(reportFile, report->error);
+			fputc('\n', reportFile);
+		}
+	}
+
+	fprintf(stdout, " Converted %d of %d files (%.1f MB) in %.3f s, %d failed ...\n", numFiles - failed, numFiles, bytes / 1e6, elapsed, failed);
+
+	if ((reportFile == NULL) || (fclose(reportFile) != 0)) {
+		fprintf(stderr, "Error: Cannot write report file '%s'.\n", reportFileName);
+		return -1;
+	}
+	fprintf(stdout, " Report written in file '%s' ...\n", reportFileName);
+
+	return failed ? -1 : 0;
+}
+
+static void plxJobFree(struct PlxJobPool *pool, struct PlxJobOrder *order)
+{
+	int i;
+
+	for (i = 0; (pool->queues != NULL) && (i < pool->numWorkers); i++) {
+		pthread_mutex_destroy(&pool->queues[i].mutex);
+		free(pool->queues[i].jobs);
+	}
+	free(pool->queues);
+	free(pool->reports);
+	free(pool->sizes);
+	free(order);
+}
+
+// Convert many files on options->jobs workers. Files are dealt to the
+// workers largest first; a failing file is recorded in the report and
+// does not stop the batch.
+int convertBatch(const char **fileNames, int numFiles, const struct PlxOptions *options, const char *reportFileName)
+{
+	struct PlxJobPool pool;
+	struct PlxJobWorker workers[PLX_MAX_THREADS];
+	pthread_t threads[PLX_MAX_THREADS];
+	struct timespec tStart, tEnd;
+	struct stat st;
+	struct PlxJobQueue *queue;
+	struct PlxJobOrder *order;
+	int i, numThreads = 0, memoryError = 0, result;
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	memset(&pool, 0, sizeof(struct PlxJobPool));
+	pool.fileNames  = fileNames;
+	pool.options    = options;
+	pool.numWorkers = (options->jobs < numFiles) ? options->jobs : numFiles;
+
+	pool.sizes   = (unsigned __int64*) calloc (numFiles, sizeof(unsigned __int64));
+	pool.reports = (struct PlxReport*) calloc (numFiles, sizeof(struct PlxReport));
+	pool.queues  = (struct PlxJobQueue*) calloc (pool.numWorkers, sizeof(struct PlxJobQueue));
+	order        = (struct PlxJobOrder*) malloc (numFiles * sizeof(struct PlxJobOrder));
+
+	for (i = 0; (pool.queues != NULL) && (i < pool.numWorkers); i++) {
+		pool.queues[i].jobs = (int*) malloc (numFiles * sizeof(int));
+		if (pool.queues[i].jobs == NULL) memoryError = 1;
+		pthread_mutex_init(&pool.queues[i].mutex, NULL);
+	}
+
+	if ((pool.sizes == NULL) || (pool.reports == NULL) || (pool.queues == NULL) || (order == NULL) || memoryError) {
+		fprintf(stderr, "Error: Out of memory.\n");
+		plxJobFree(&pool, order);
+		return PLX_ERR_MEMORY;
+	}
+
+	// largest first, dealt round robin so every worker starts with a big job
+	for (i = 0; i < numFiles; i++) {
+		if (stat(fileNames[i], &st) == 0) pool.sizes[i] = (unsigned __int64) st.st_size;
+		pool.reports[i].fileName = fileNames[i];
+		order[i].size  = pool.sizes[i];
+		order[i].index = i;
+	}
+
+	qsort(order, numFiles, sizeof(struct PlxJobOrder), plxJobCompare);
+
+	for (i = 0; i < numFiles; i++) {
+		queue = &pool.queues[i % pool.numWorkers];
+		queue->jobs[queue->tail++] = order[i].index;
+	}
+
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.released, NULL);
+
+	fprintf(stdout, "\nplx2csv version 0.1.1, Copyright (c) 2011 by Gerold Bausch\n");
+	fprintf(stdout, " Converting %d files on %d workers ...\n", numFiles, pool.numWorkers);
+
+	for (i = 0; i < pool.numWorkers; i++) {
+		workers[i].pool  = &pool;
+		workers[i].index = i;
+		if (pthread_create(&threads[numThreads], NULL, plxJobWorker, &workers[i]) == 0) numThreads++;
+	}
+
+	// without any thread the jobs are run here
+	if (numThreads == 0) {
+		workers[0].pool  = &pool;
+		workers[0].index = 0;
+		plxJobWorker(&workers[0]);
+	}
+
+	for (i = 0; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool.released);
+	pthread_mutex_destroy(&pool.mutex);
+
+	clock_gettime(CLOCK_MONOTONIC, &tEnd);
+	result = plxJobReport(&pool, numFiles, reportFileName, (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) * 1e-9);
+
+	fprintf(stdout, " Done!\n\n");
+
+	plxJobFree(&pool, order);
+
+	return result;
+}
@@ -0,0 +1,231 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxmerge.h"
+
+// Heap order: earlier block first, equal timestamps in input order
+static int plxMergeBefore(const struct PlxMerge *merge, int a, int b)
+{
+	const struct PlxMergeSource *sa = &merge->sources[a];
+	const struct PlxMergeSource *sb = &merge->sources[b];
+	__int64 ta = sa->batch.timestamp[sa->next];
+	__int64 tb = sb->batch.timestamp[sb->next];
+
+	return (ta < tb) || ((ta == tb) && (a < b));
+}
+
+static void plxMergeSiftDown(struct PlxMerge *merge, int i)
+{
+	int child, top = merge->heap[i];
+
+	while ((child = 2 * i + 1) < merge->heapSize) {
+		if ((child + 1 < merge->heapSize) && plxMergeBefore(merge, merge->heap[child + 1], merge->heap[child])) child++;
+		if (!plxMergeBefore(merge, merge->heap[child], top)) break;
+		merge->heap[i] = merge->heap[child];
+		i = child;
+	}
+	merge->heap[i] = top;
+}
+
+// Decode the next batch of an input, 0 at its end
+static int plxMergeFill(struct PlxMerge *merge, int s)
+{
+	struct PlxMergeSource *source = &merge->sources[s];
+
+	source->next = 0;
+	return plxDecoderNext(&source->decoder, &source->batch);
+}
+
+// Open the readers of all input files (headers only). On error failed is
+// the input that could not be opened.
+int plxMergeOpen(struct PlxMerge *merge, const char **fileNames, int numFiles, int mode)
+{
+	int i, result;
+
+	memset(merge, 0, sizeof(struct PlxMerge));
+	merge->failed = -1;
+
+	merge->sources = (struct PlxMergeSource*) calloc (numFiles, sizeof(struct PlxMergeSource));
+	if (merge->sources == NULL) return PLX_ERR_MEMORY;
+	merge->numSources = numFiles;
+
+	for (i = 0; i < numFiles; i++) {
+
+		merge->sources[i].fileName = fileNames[i];
+		merge->sources[i].isOpen   = 1;
+
+		result = plxReaderOpen(&merge->sources[i].reader, fileNames[i], mode);
+		if (result != 0) {
+			merge->failed = i;
+			return result;
+		}
+	}
+
+	return 0;
+}
+
+// Channel offsets of the inputs: "auto" moves the channels of every file
+// behind the DSP channels of the files before it, otherwise list holds one
+// offset per input ("0,32,64"; missing entries are 0)
+int plxMergeRenumber(struct PlxMerge *merge, const char *list)
+{
+	const char *p = list;
+	char *end;
+	int i, offset = 0;
+
+	for (i = 0; i < merge->numSources; i++) {
+
+		if (!strcmp(list, "auto")) {
+			merge->sources[i].channelOffset = offset;
+			offset += merge->sources[i].reader.fileHeader.NumDSPChannels;
+			continue;
+		}
+
+		if (*p == '\0') {
+			merge->sources[i].channelOffset = 0;
+			continue;
+		}
+
+		merge->sources[i].channelOffset = (int) strtol(p, &end, 10);
+		if ((end == p) || ((*end != ',') && (*end != '\0'))) return -1;
+		p = (*end == ',') ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+// Allocate the input batches and decode the first blocks of every input.
+// capacity is the number of blocks of the batches passed to plxMergeNext.
+int plxMergeStart(struct PlxMerge *merge, const struct PlxFilter *filter, int capacity)
+{
+	struct PlxMergeSource *source;
+	int i;
+
+	merge->heap   = (int*) malloc (merge->numSources * sizeof(int));
+	merge->source = (int*) malloc (capacity * sizeof(int));
+	if ((merge->heap == NULL) || (merge->source == NULL)) return PLX_ERR_MEMORY;
+	merge->sourceCapacity = capacity;
+
+	for (i = 0; i < merge->numSources; i++) {
+
+		source = &merge->sources[i];
+
+		if (plxBatchAlloc(&source->batch, PLX_MERGE_BLOCKS, PLX_MERGE_BLOCKS * source->reader.fileHeader.NumPointsWave) != 0) return PLX_ERR_MEMORY;
+
+		plxDecoderInit(&source->decoder, &source->reader);
+		source->decoder.filter = filter;
+
+		if (plxMergeFill(merge, i)) merge->heap[merge->heapSize++] = i;
+	}
+
+	for (i = merge->heapSize / 2 - 1; i >= 0; i--) plxMergeSiftDown(merge, i);
+
+	return 0;
+}
+
+// Fill batch with the next blocks of all inputs in timestamp order. The
+// channel offsets are applied, source[i] is the input of block i.
+// Returns the number of blocks, 0 after the last block of every input.
+int plxMergeNext(struct PlxMerge *merge, struct PlxBatch *batch)
+{
+	struct PlxMergeSource *source;
+	const struct PlxBatch *from;
+	int i, j, s, words;
+
+	batch->count      = 0;
+	batch->numSamples = 0;
+
+	while ((batch->count < batch->capacity) && (batch->count < merge->sourceCapacity) && (merge->heapSize > 0)) {
+
+		s      = merge->heap[0];
+		source = &merge->sources[s];
+		from   = &source->batch;
+		j      = source->next;
+
+		// samples stored for the block (oversized blocks are truncated by the decoder)
+		words = ((j + 1 < from->count) ? from->sampleStart[j + 1] : from->numSamples) - from->sampleStart[j];
+		if (batch->numSamples + words > batch->sampleCapacity) {
+			if (batch->count > 0) break;
+			words = batch->sampleCapacity;
+		}
+
+		i = batch->count++;
+
+		batch->type[i]         = from->type[j];
+		batch->timestamp[i]    = from->timestamp[j];
+		batch->channel[i]      = from->channel[j];
+		batch->unit[i]         = from->unit[j];
+		batch->numWaveforms[i] = from->numWaveforms[j];
+		batch->numWords[i]     = from->numWords[j];
+		batch->sampleStart[i]  = batch->numSamples;
+		batch->offset[i]       = from->offset[j];
+		merge->source[i]       = s;
+
+		// event channels are event numbers and keep them
+		if (from->type[j] != 4) batch->channel[i] += source->channelOffset;
+
+		if (words > 0) memcpy(&batch->samples[batch->numSamples], &from->samples[from->sampleStart[j]], words * sizeof(short));
+		batch->numSamples += words;
+
+		// next block of this input, or drop the input at its end
+		if ((++source->next == from->count) && !plxMergeFill(merge, s)) {
+			merge->heap[0] = merge->heap[--merge->heapSize];
+		}
+		if (merge->heapSize > 0) plxMergeSiftDown(merge, 0);
+	}
+
+	return batch->count;
+}
+
+// Input bytes read so far by all inputs
+unsigned __int64 plxMergeBytes(const struct PlxMerge *merge)
+{
+	unsigned __int64 bytes = 0;
+	int i;
+
+	for (i = 0; i < merge->numSources; i++) {
+		if (merge->sources[i].isOpen) bytes += merge->sources[i].reader.offset;
+	}
+
+	return bytes;
+}
+
+void plxMergeClose(struct PlxMerge *merge)
+{
+	int i;
+
+	for (i = 0; i < merge->numSources; i++) {
+		if (!merge->sources[i].isOpen) continue;
+		plxReaderClose(&merge->sources[i].reader);
+		plxBatchFree(&merge->sources[i].batch);
+	}
+
+	free(merge->sources);
+	free(merge->heap);
+	free(merge->source);
+
+	memset(merge, 0, sizeof(struct PlxMerge));
+}
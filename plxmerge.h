@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXMERGE_H__
+#define __PLXMERGE_H__
+
+#pragma once
+#include "plxdecode.h"
+
+// Blocks decoded ahead per input file
+#define PLX_MERGE_BLOCKS		1024
+
+// One input of a merge: its reader, decoder and the batch the next blocks
+// are taken from
+struct PlxMergeSource
+{
+	const char 			*fileName;
+	struct PlxReader 	reader;
+	struct PlxDecoder 	decoder;
+	struct PlxBatch 	batch;
+	int 				next;				// next block of batch
+	int 				isOpen;
+	int 				channelOffset;		// added to spike and continuous channel numbers
+};
+
+// k-way merge of the block streams of several plx files by their 40 bit
+// timestamp. Every file is decoded on its own into a small batch, a binary
+// heap keyed by (timestamp, input) picks the input with the earliest block
+// next. Memory use is one batch per input, independent of the file sizes.
+// Blocks of one input keep their order and equal timestamps are taken in
+// input order. The filter is applied to the original channel numbers.
+struct PlxMerge
+{
+	struct PlxMergeSource *sources;
+	int 	numSources;
+	int 	failed;					// input that could not be opened (plxMergeOpen)
+	int 	*heap;					// inputs with blocks left, earliest block first
+	int 	heapSize;
+	int 	*source;				// input of every block of the last merged batch
+	int 	sourceCapacity;
+};
+
+// Merge functions
+int  plxMergeOpen(struct PlxMerge *merge, const char **fileNames, int numFiles, int mode);
+int  plxMergeRenumber(struct PlxMerge *merge, const char *list);
+int  plxMergeStart(struct PlxMerge *merge, const struct PlxFilter *filter, int capacity);
+int  plxMergeNext(struct PlxMerge *merge, struct PlxBatch *batch);
+unsigned __int64 plxMergeBytes(const struct PlxMerge *merge);
+void plxMergeClose(struct PlxMerge *merge);
+
+#endif
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "plxnpy.h"
+
+// Format .npy header for an array of rows (x width) values of type descr
+static void plxNpyHeader(char *header, const char *descr, __int64 rows, int width)
+{
+	int length;
+
+	memset(header, ' ', PLX_NPY_HEADER_SIZE);
+	memcpy(header, "\x93NUMPY\x01\x00", 8);
+	header[8] = (char)((PLX_NPY_HEADER_SIZE - 10) & 0xFF);
+	header[9] = (char)((PLX_NPY_HEADER_SIZE - 10) >> 8);
+
+	if (width > 0) {
+		length = snprintf(header + 10, PLX_NPY_HEADER_SIZE - 10, "{'descr': '%s', 'fortran_order': False, 'shape': (%lld, %d), }", descr, rows, width);
+	} else {
+		length = snprintf(header + 10, PLX_NPY_HEADER_SIZE - 10, "{'descr': '%s', 'fortran_order': False, 'shape': (%lld,), }", descr, rows);
+	}
+
+	// pad the dictionary with spaces up to the terminating newline
+	header[10 + length] = ' ';
+	header[PLX_NPY_HEADER_SIZE - 1] = '\n';
+}
+
+// Open <baseName>.<name>.npy for rows of width values (0: one value per
+// row), presized for expectedRows
+int plxNpyColumnOpen(struct PlxNpyColumn *column, const char *baseName, const char *name, const char *descr, int width, int valueBytes, __int64 expectedRows)
+{
+	char fileName[1024];
+	char header[PLX_NPY_HEADER_SIZE];
+
+	column->descr    = descr;
+	column->width    = width;
+	column->rowBytes = (width > 0) ? width * valueBytes : valueBytes;
+
+	snprintf(fileName, sizeof(fileName), "%s.%s.npy", baseName, name);
+
+	column->file = fopen(fileName, "wb");
+	if (column->file == NULL) return PLX_ERR_OPEN;
+
+	if (plxOutBufInit(&column->out, column->file, PLX_NPY_OUTBUF_SIZE) != 0) return PLX_ERR_MEMORY;
+
+	// reserve the expected file size up front to avoid fragmentation
+	if (expectedRows > 0) posix_fallocate(fileno(column->file), 0, (off_t)(PLX_NPY_HEADER_SIZE + expectedRows * column->rowBytes));
+
+	plxNpyHeader(header, descr, expectedRows, width);
+	if (fwrite(header, 1, PLX_NPY_HEADER_SIZE, column->file) != PLX_NPY_HEADER_SIZE) return PLX_ERR_OPEN;
+
+	return 0;
+}
+
+// Flush column, rewrite the header with the final shape and cut off unused
+// presized space
+int plxNpyColumnClose(struct PlxNpyColumn *column, __int64 rows)
+{
+	char header[PLX_NPY_HEADER_SIZE];
+	int error = 0;
+
+	if (column->file == NULL) {
+		free(column->out.data);
+		return 0;
+	}
+
+	plxOutBufFree(&column->out);
+	if (column->out.error) error = 1;
+
+	plxNpyHeader(header, column->descr, rows, column->width);
+
+	if ((fflush(column->file) != 0) || (fseeko(column->file, 0, SEEK_SET) != 0) ||
+		(fwrite(header, 1, PLX_NPY_HEADER_SIZE, column->file) != PLX_NPY_HEADER_SIZE) || (fflush(column->file) != 0) ||
+		(ftruncate(fileno(column->file), (off_t)(PLX_NPY_HEADER_SIZE + rows * column->rowBytes)) != 0)) {
+		error = 1;
+	}
+
+	if (fclose(column->file) != 0) error = 1;
+	column->file = NULL;
+
+	return error ? -1 : 0;
+}
+
+// Spike counter (TSCounts) of a channel and unit in the file header, 0 if
+// not counted. The counters only cover the first 4 units of channels 1..129.
+__int64 plxNpySpikeCount(const struct PL_FileHeader *fileHeader, int channel, int unit)
+{
+	if ((channel < 1) || (channel >= 130) || (unit < 0) || (unit >= 5)) return 0;
+	return (fileHeader->TSCounts[channel][unit] > 0) ? fileHeader->TSCounts[channel][unit] : 0;
+}
+
+// Spikes of all channels and units counted in the file header
+__int64 plxNpySpikeTotal(const struct PL_FileHeader *fileHeader)
+{
+	__int64 total = 0;
+	int channel, unit;
+
+	for (channel = 1; channel < 130; channel++) {
+		for (unit = 0; unit < 5; unit++) total += plxNpySpikeCount(fileHeader, channel, unit);
+	}
+
+	return total;
+}
+
+// Open the timestamps, channel and unit columns every spike writer has
+int plxNpyOpenIds(struct PlxNpyColumn *timestamps, struct PlxNpyColumn *channel, struct PlxNpyColumn *unit, const char *baseName, __int64 expectedRows)
+{
+	if ((plxNpyColumnOpen(timestamps, baseName, "timestamps", "<i8", 0, sizeof(__int64), expectedRows) != 0) ||
+		(plxNpyColumnOpen(channel, baseName, "channel", "<i2", 0, sizeof(short), expectedRows) != 0) ||
+		(plxNpyColumnOpen(unit, baseName, "unit", "<i2", 0, sizeof(short), expectedRows) != 0)) {
+		return PLX_ERR_OPEN;
+	}
+
+	return 0;
+}
+
+// Open the column files <baseName>.<column>.npy. With presize the arrays
+// are sized from the spike counters (TSCounts) of the file header.
+int plxNpyOpen(struct PlxNpyWriter *writer, const struct PlxReader *reader, const char *baseName, int presize, const struct PlxScaleTable *scale)
+{
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	int width = fileHeader->NumPointsWave;
+
+	memset(writer, 0, sizeof(struct PlxNpyWriter));
+	writer->scale = scale;
+
+	if (width < 1) width = 1;
+	if (presize) writer->expectedRows = plxNpySpikeTotal(fileHeader);
+
+	if ((plxNpyOpenIds(&writer->timestamps, &writer->channel, &writer->unit, baseName, writer->expectedRows) != 0) ||
+		(plxNpyColumnOpen(&writer->waveforms, baseName, "waveforms", (scale != NULL) ? "<f4" : "<i2", width,
+			(scale != NULL) ? sizeof(float) : sizeof(short), writer->expectedRows) != 0)) {
+		plxNpyClose(writer);
+		return PLX_ERR_OPEN;
+	}
+
+	return 0;
+}
+
+// Append the spike blocks of a batch to the columns
+void plxNpyBatch(struct PlxNpyWriter *writer, const struct PlxBatch *batch)
+{
+	__int64 *pTimestamp;
+	short *pChannel, *pUnit;
+	char *pWaveform;
+	int j, rows = 0, words, width = writer->waveforms.width;
+
+	for (j = 0; j < batch->count; j++) if (batch->type[j] == 1) rows++;
+	if (rows == 0) return;
+
+	pTimestamp = (__int64*) plxOutBufReserve(&writer->timestamps.out, rows * sizeof(__int64));
+	pChannel   = (short*) plxOutBufReserve(&writer->channel.out, rows * sizeof(short));
+	pUnit      = (short*) plxOutBufReserve(&writer->unit.out, rows * sizeof(short));
+	pWaveform  = plxOutBufReserve(&writer->waveforms.out, (size_t) rows * writer->waveforms.rowBytes);
+
+	if ((pTimestamp == NULL) || (pChannel == NULL) || (pUnit == NULL) || (pWaveform == NULL)) {
+		writer->error = 1;
+		return;
+	}
+
+	for (j = 0; j < batch->count; j++) {
+
+		if (batch->type[j] != 1) continue;
+
+		*pTimestamp++ = batch->timestamp[j];
+		*pChannel++   = batch->channel[j];
+		*pUnit++      = batch->unit[j];
+
+		// first waveform of the block, samples copied as they are
+		words = ((batch->numWaveforms[j] > 0) && (batch->numWords[j] > 0)) ? batch->numWords[j] : 0;
+		if (words > batch->numSamples - batch->sampleStart[j]) words = batch->numSamples - batch->sampleStart[j];
+		if (words > width) words = width;
+
+		if (writer->scale != NULL) {
+			plxScaleSamples((float*) pWaveform, &batch->samples[batch->sampleStart[j]], words, plxScaleGet(writer->scale, batch->channel[j]));
+			if (words < width) memset(pWaveform + words * sizeof(float), 0, (width - words) * sizeof(float));
+		} else {
+			memcpy(pWaveform, &batch->samples[batch->sampleStart[j]], words * sizeof(short));
+			if (words < width) memset(pWaveform + words * sizeof(short), 0, (width - words) * sizeof(short));
+		}
+		pWaveform += writer->waveforms.rowBytes;
+	}
+
+	writer->timestamps.out.used += rows * sizeof(__int64);
+	writer->channel.out.used    += rows * sizeof(short);
+	writer->unit.out.used       += rows * sizeof(short);
+	writer->waveforms.out.used  += (size_t) rows * writer->waveforms.rowBytes;
+	writer->rows += rows;
+}
+
+int plxNpyClose(struct PlxNpyWriter *writer)
+{
+	if (writer->timestamps.out.error || writer->channel.out.error || writer->unit.out.error || writer->waveforms.out.error) writer->error = 1;
+
+	if (plxNpyColumnClose(&writer->timestamps, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->channel, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->unit, writer->rows) != 0) writer->error = 1;
+	if (plxNpyColumnClose(&writer->waveforms, writer->rows) != 0) writer->error = 1;
+
+	return writer->error ? -1 : 0;
+}
+
+// Write the file header values needed to interpret the columns as
+// "name,value" lines
+int plxNpyWriteMeta(const struct PlxReader *reader, const char *fileName)
+{
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	FILE *metaFile;
+
+	metaFile = fopen(fileName, "w");
+	if (metaFile == NULL) return PLX_ERR_OPEN;
+
+	fprintf(metaFile, "Version,%d\n", fileHeader->Version);
+	fprintf(metaFile, "Timestamp,%4d-%02d-%02d %02d:%02d:%02d\n", fileHeader->Year, fileHeader->Month, fileHeader->Day,
+		fileHeader->Hour, fileHeader->Minute, fileHeader->Second);
+	fprintf(metaFile, "ADFrequency,%d\n", fileHeader->ADFrequency);
+	fprintf(metaFile, "WaveformFreq,%d\n", fileHeader->WaveformFreq);
+	fprintf(metaFile, "LastTimestamp,%.0f\n", fileHeader->LastTimestamp);
+	fprintf(metaFile, "NumDSPChannels,%d\n", fileHeader->NumDSPChannels);
+	fprintf(metaFile, "NumEventChannels,%d\n", fileHeader->NumEventChannels);
+	fprintf(metaFile, "NumSlowChannels,%d\n", fileHeader->NumSlowChannels);
+	fprintf(metaFile, "NumPointsWave,%d\n", fileHeader->NumPointsWave);
+	fprintf(metaFile, "NumPointsPreThr,%d\n", fileHeader->NumPointsPreThr);
+	fprintf(metaFile, "Trodalness,%d\n", fileHeader->Trodalness);
+	fprintf(metaFile, "BitsPerSpikeSample,%d\n", fileHeader->BitsPerSpikeSample);
+	fprintf(metaFile, "BitsPerSlowSample,%d\n", fileHeader->BitsPerSlowSample);
+	fprintf(metaFile, "SpikeMaxMagnitudeMV,%d\n", fileHeader->SpikeMaxMagnitudeMV);
+	fprintf(metaFile, "SlowMaxMagnitudeMV,%d\n", fileHeader->SlowMaxMagnitudeMV);
+	fprintf(metaFile, "SpikePreAmpGain,%d\n", fileHeader->SpikePreAmpGain);
+
+	return (fclose(metaFile) != 0) ? -1 : 0;
+}
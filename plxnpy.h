@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXNPY_H__
+#define __PLXNPY_H__
+
+#pragma once
+#include "plxscale.h"
+
+// Size of the NumPy (.npy version 1.0) header incl. magic, padded so the
+// shape can be rewritten in place when the number of rows is known
+#define PLX_NPY_HEADER_SIZE		128
+
+// Output buffer per column file (bytes)
+#define PLX_NPY_OUTBUF_SIZE		(1 << 20)
+
+// One fixed-width column file
+struct PlxNpyColumn
+{
+	FILE 				*file;
+	struct PlxOutBuf 	out;
+	const char 			*descr;			// NumPy type string, e.g. "<i8"
+	int 				width;			// values per row (0: one-dimensional array)
+	int 				rowBytes;		// bytes per row
+};
+
+// Writer for spike blocks as columns in .npy files: timestamps (int64
+// ticks), channel and unit (int16) and the waveform matrix (int16, one row
+// of NumPointsWave samples per block). Waveform samples are copied as they
+// are (or as float32 microvolts with a scale table); shorter waveforms are
+// padded with zeros, longer ones truncated.
+struct PlxNpyWriter
+{
+	struct PlxNpyColumn 	timestamps;
+	struct PlxNpyColumn 	channel;
+	struct PlxNpyColumn 	unit;
+	struct PlxNpyColumn 	waveforms;
+	const struct PlxScaleTable *scale;		// waveforms in microvolts or NULL for raw samples
+	__int64 				expectedRows;	// rows presized from the file header counters
+	__int64 				rows;			// rows written
+	int 					error;
+};
+
+// NumPy column functions
+int  plxNpyColumnOpen(struct PlxNpyColumn *column, const char *baseName, const char *name, const char *descr, int width, int valueBytes, __int64 expectedRows);
+int  plxNpyColumnClose(struct PlxNpyColumn *column, __int64 rows);
+__int64 plxNpySpikeCount(const struct PL_FileHeader *fileHeader, int channel, int unit);
+__int64 plxNpySpikeTotal(const struct PL_FileHeader *fileHeader);
+int  plxNpyOpenIds(struct PlxNpyColumn *timestamps, struct PlxNpyColumn *channel, struct PlxNpyColumn *unit, const char *baseName, __int64 expectedRows);
+int  plxNpyOpen(struct PlxNpyWriter *writer, const struct PlxReader *reader, const char *baseName, int presize, const struct PlxScaleTable *scale);
+void plxNpyBatch(struct PlxNpyWriter *writer, const struct PlxBatch *batch);
+int  plxNpyClose(struct PlxNpyWriter *writer);
+int  plxNpyWriteMeta(const struct PlxReader *reader, const char *fileName);
+
+#endif
@@ -0,0 +1,274 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <pthread.h>
+
+#include "plx2csv.h"
+
+// Input bytes per chunk
+#define PLX_CHUNK_BYTES		(4 << 20)
+
+// Chunk states
+#define PLX_CHUNK_FREE		0
+#define PLX_CHUNK_QUEUED	1
+#define PLX_CHUNK_DONE		2
+
+// Chunk of consecutive data blocks, formatted by one worker
+struct PlxChunk
+{
+	unsigned __int64 	start;			// offset of the first block
+	unsigned __int64 	end;			// offset behind the last block
+	int 				state;
+	struct PlxOutBuf 	out;			// formatted rows (in memory)
+	struct PlxCounts 	counts;
+};
+
+// State shared between the scanning/writing thread and the workers
+struct PlxParallel
+{
+	pthread_mutex_t 	mutex;
+	pthread_cond_t 		queued;			// a chunk was queued or the job is finished
+	pthread_cond_t 		done;			// a chunk was formatted
+
+	struct PlxChunk 	*chunks;		// ring of chunk slots
+	int 				numChunks;
+	long long 			nextQueue;		// sequence number of the next chunk to scan
+	long long 			nextWork;		// sequence number of the next chunk to format
+	int 				finished;
+	int 				error;
+
+	struct PlxReader 		reader;		// snapshot of the reader the chunk views are made from
+	const struct PlxOptions *options;
+	struct PlxStats 		*stats;		// -stats of the calling thread or NULL, workers merge into it
+};
+
+// Worker thread: decode and format queued chunks
+static void *plxParallelWorker(void *arg)
+{
+	struct PlxParallel *parallel = (struct PlxParallel*) arg;
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	struct PlxBatch batch;
+	struct PlxChunk *chunk;
+	struct PlxStats stats;
+	int frequency = parallel->reader.fileHeader.ADFrequency;
+
+	if (parallel->stats != NULL) {
+		plxStatsInit(&stats, parallel->stats);
+		plxStatsBind(&stats);
+	}
+
+	if (plxBatchAlloc(&batch, PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * parallel->reader.fileHeader.NumPointsWave) != 0) {
+		pthread_mutex_lock(&parallel->mutex);
+		parallel->error = 1;
+		pthread_mutex_unlock(&parallel->mutex);
+	}
+
+	for (;;) {
+
+		// wait for the next chunk
+		pthread_mutex_lock(&parallel->mutex);
+		while (!parallel->finished && (parallel->nextWork >= parallel->nextQueue)) {
+			pthread_cond_wait(&parallel->queued, &parallel->mutex);
+		}
+		if (parallel->nextWork >= parallel->nextQueue) {
+			pthread_mutex_unlock(&parallel->mutex);
+			break;
+		}
+		chunk = &parallel->chunks[parallel->nextWork++ % parallel->numChunks];
+		pthread_mutex_unlock(&parallel->mutex);
+
+		// format all blocks of the chunk into its buffer
+		plxReaderView(&parallel->reader, &view, chunk->start, chunk->end);
+		plxDecoderInit(&decoder, &view);
+		decoder.filter = &parallel->options->filter;
+
+		chunk->out.used = 0;
+		memset(&chunk->counts, 0, sizeof(struct PlxCounts));
+
+		while (plxDecoderNext(&decoder, &batch)) {
+			plxStatsPhase(plxStatsCurrent(), PLX_PHASE_FORMAT);
+			formatCsvBatch(parallel->options, &batch, frequency, &chunk->out, &chunk->counts);
+			plxStatsPhase(plxStatsCurrent(), PLX_PHASE_IDLE);
+		}
+
+		pthread_mutex_lock(&parallel->mutex);
+		chunk->state = PLX_CHUNK_DONE;
+		pthread_cond_broadcast(&parallel->done);
+		pthread_mutex_unlock(&parallel->mutex);
+	}
+
+	if (parallel->stats != NULL) {
+		pthread_mutex_lock(&parallel->mutex);
+		plxStatsMerge(parallel->stats, &stats);
+		pthread_mutex_unlock(&parallel->mutex);
+	}
+
+	plxBatchFree(&batch);
+	return NULL;
+}
+
+// Chunk slot can be queued again (its rows were written)
+static int plxParallelFree(struct PlxParallel *parallel, const struct PlxChunk *chunk)
+{
+	int isFree;
+
+	pthread_mutex_lock(&parallel->mutex);
+	isFree = (chunk->state == PLX_CHUNK_FREE);
+	pthread_mutex_unlock(&parallel->mutex);
+
+	return isFree;
+}
+
+// Convert all data blocks of a mapped reader on options->threads workers.
+// The calling thread finds chunk boundaries by hopping over block headers
+// and writes the formatted chunks in their original order, so the output
+// is identical to a single-threaded conversion.
+int convertCsvParallel(struct PlxReader *reader, const struct PlxOptions *options, FILE *csvOutFile, struct PlxCounts *counts)
+{
+	struct PlxParallel parallel;
+	struct PlxChunk *chunk;
+	struct PL_DataBlockHeader header;
+	pthread_t workers[PLX_MAX_THREADS];
+	unsigned __int64 chunkBytes;
+	long long nextWrite = 0;
+	int i, phase, numWorkers = 0, scanEnd = 0;
+
+	memset(&parallel, 0, sizeof(struct PlxParallel));
+	pthread_mutex_init(&parallel.mutex, NULL);
+	pthread_cond_init(&parallel.queued, NULL);
+	pthread_cond_init(&parallel.done, NULL);
+
+	plxReaderView(reader, &parallel.reader, reader->offset, reader->size);
+	parallel.options   = options;
+	parallel.stats     = plxStatsCurrent();
+	parallel.numChunks = 2 * options->threads;
+	parallel.chunks    = (struct PlxChunk*) calloc (parallel.numChunks, sizeof(struct PlxChunk));
+
+	if (parallel.chunks == NULL) return PLX_ERR_MEMORY;
+
+	for (i = 0; i < parallel.numChunks; i++) {
+		plxOutBufInit(&parallel.chunks[i].out, NULL, PLX_CHUNK_BYTES);
+	}
+
+	// the chunks in flight span half a read-ahead window at most
+	chunkBytes = PLX_READER_WINDOW / (2 * parallel.numChunks);
+	if (chunkBytes > PLX_CHUNK_BYTES) chunkBytes = PLX_CHUNK_BYTES;
+
+	for (i = 0; i < options->threads; i++) {
+		if (pthread_create(&workers[numWorkers], NULL, plxParallelWorker, &parallel) == 0) numWorkers++;
+	}
+
+	phase = plxStatsPhase(parallel.stats, PLX_PHASE_IDLE);
+
+	while (numWorkers > 0) {
+
+		// pages of chunks not written yet must stay mapped for the workers
+		reader->releaseLimit = (nextWrite < parallel.nextQueue) ? parallel.chunks[nextWrite % parallel.numChunks].start : reader->offset;
+
+		// queue chunks while there are free slots
+		chunk = &parallel.chunks[parallel.nextQueue % parallel.numChunks];
+		while (!scanEnd && plxParallelFree(&parallel, chunk)) {
+
+			plxStatsPhase(parallel.stats, PLX_PHASE_DECODE);
+			chunk->start = reader->offset;
+			while (reader->offset - chunk->start < chunkBytes) {
+				if (!plxReaderNextHeader(reader, &header) || !plxReaderSkip(reader)) {
+					scanEnd = 1;
+					break;
+				}
+			}
+			chunk->end = reader->offset;
+			plxStatsPhase(parallel.stats, PLX_PHASE_IDLE);
+			if (chunk->end == chunk->start) break;
+
+			pthread_mutex_lock(&parallel.mutex);
+			chunk->state = PLX_CHUNK_QUEUED;
+			parallel.nextQueue++;
+			pthread_cond_signal(&parallel.queued);
+			pthread_mutex_unlock(&parallel.mutex);
+
+			chunk = &parallel.chunks[parallel.nextQueue % parallel.numChunks];
+		}
+
+		if (nextWrite == parallel.nextQueue) break;
+
+		// write the oldest chunk once it is formatted
+		chunk = &parallel.chunks[nextWrite % parallel.numChunks];
+
+		pthread_mutex_lock(&parallel.mutex);
+		while (chunk->state != PLX_CHUNK_DONE) {
+			pthread_cond_wait(&parallel.done, &parallel.mutex);
+		}
+		pthread_mutex_unlock(&parallel.mutex);
+
+		plxStatsPhase(parallel.stats, PLX_PHASE_WRITE);
+		if ((fwrite(chunk->out.data, 1, chunk->out.used, csvOutFile) != chunk->out.used) || chunk->out.error) {
+			pthread_mutex_lock(&parallel.mutex);
+			parallel.error = 1;
+			pthread_mutex_unlock(&parallel.mutex);
+		}
+		if (parallel.stats != NULL) parallel.stats->bytesOut += chunk->out.used;
+		plxStatsPhase(parallel.stats, PLX_PHASE_IDLE);
+		plxStatsProgress(parallel.stats, chunk->end);
+
+		counts->spikes += chunk->counts.spikes;
+		counts->events += chunk->counts.events;
+		counts->slow   += chunk->counts.slow;
+
+		pthread_mutex_lock(&parallel.mutex);
+		chunk->state = PLX_CHUNK_FREE;
+		pthread_mutex_unlock(&parallel.mutex);
+		nextWrite++;
+	}
+
+	counts->bytes = reader->offset;
+	reader->releaseLimit = ~0ULL;
+	plxStatsPhase(parallel.stats, phase);
+
+	// stop workers
+	pthread_mutex_lock(&parallel.mutex);
+	parallel.finished = 1;
+	pthread_cond_broadcast(&parallel.queued);
+	pthread_mutex_unlock(&parallel.mutex);
+
+	for (i = 0; i < numWorkers; i++) {
+		pthread_join(workers[i], NULL);
+	}
+
+	for (i = 0; i < parallel.numChunks; i++) {
+		plxOutBufFree(&parallel.chunks[i].out);
+	}
+	free(parallel.chunks);
+
+	pthread_cond_destroy(&parallel.done);
+	pthread_cond_destroy(&parallel.queued);
+	pthread_mutex_destroy(&parallel.mutex);
+
+	if (numWorkers == 0) return PLX_ERR_MEMORY;
+
+	return parallel.error ? -1 : 0;
+}
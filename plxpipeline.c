@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "plx2csv.h"
+
+// Slots per ring and formatted bytes per write
+#define PLX_PIPE_SLOTS		4
+#define PLX_PIPE_WRITE		(1 << 20)
+
+// Bounded single producer/single consumer ring. Slots are filled and
+// consumed in place: the producer owns slot head % PLX_PIPE_SLOTS until it
+// advances head, the consumer owns slot tail % PLX_PIPE_SLOTS until it
+// advances tail. Both counters live on their own cache line.
+struct PlxRing
+{
+	unsigned int head __attribute__((aligned(64)));		// slots published by the producer
+	unsigned int tail __attribute__((aligned(64)));		// slots released by the consumer
+	int 		 closed;								// producer is done
+};
+
+// Formatted rows of one or more batches
+struct PlxPipeOut
+{
+	struct PlxOutBuf 	out;
+	struct PlxCounts 	counts;
+};
+
+// Decode -> format -> write
+struct PlxPipeline
+{
+	struct PlxRing 		batchRing;
+	struct PlxBatch 	batches[PLX_PIPE_SLOTS];
+	struct PlxRing 		outRing;
+	struct PlxPipeOut 	outs[PLX_PIPE_SLOTS];
+
+	struct PlxReader 		*reader;
+	const struct PlxOptions *options;
+	const struct PlxIndex 	*index;
+	unsigned __int64 		bytes;			// input bytes read by the decode stage
+	int 					abort;			// the write stage failed
+
+	struct PlxStats 		*stats;			// -stats of the calling thread or NULL
+	struct PlxStats 		decodeStats;	// stage counters, merged into stats
+	struct PlxStats 		formatStats;
+};
+
+// Back off while a ring is full or empty: spin first, then yield, then
+// sleep so a stage waiting on the disk does not burn a core
+static void plxRingBackoff(int *spins)
+{
+	struct timespec pause = { 0, 50000 };
+
+	if (++(*spins) < 64) return;
+	if (*spins < 256) sched_yield();
+	else nanosleep(&pause, NULL);
+}
+
+// Producer: index of a free slot, -1 once the pipeline was aborted (also
+// if the ring is not full, the consumers stop draining it)
+static int plxRingAcquire(struct PlxRing *ring, const int *abort)
+{
+	unsigned int head = ring->head;
+	int spins = 0;
+
+	for (;;) {
+		if (__atomic_load_n(abort, __ATOMIC_RELAXED)) return -1;
+		if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != PLX_PIPE_SLOTS) break;
+		plxRingBackoff(&spins);
+	}
+
+	return head % PLX_PIPE_SLOTS;
+}
+
+static void plxRingPublish(struct PlxRing *ring)
+{
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+static void plxRingClose(struct PlxRing *ring)
+{
+	__atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+// Consumer: index of the oldest published slot, -1 once the ring is closed
+// and empty
+static int plxRingPeek(struct PlxRing *ring)
+{
+	unsigned int tail = ring->tail;
+	int spins = 0;
+
+	while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+		if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+			// a slot may have been published right before closing
+			if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != tail) break;
+			return -1;
+		}
+		plxRingBackoff(&spins);
+	}
+
+	return tail % PLX_PIPE_SLOTS;
+}
+
+static void plxRingRelease(struct PlxRing *ring)
+{
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+// Decode stage: read blocks into batch slots. With an index only the
+// segments that can contain accepted blocks are read.
+static int plxPipeDecode(struct PlxPipeline *pipeline, struct PlxDecoder *decoder)
+{
+	int slot;
+
+	for (;;) {
+		if ((slot = plxRingAcquire(&pipeline->batchRing, &pipeline->abort)) < 0) return 0;
+		if (!plxDecoderNext(decoder, &pipeline->batches[slot])) return 1;
+		plxRingPublish(&pipeline->batchRing);
+	}
+}
+
+static void *plxPipeDecodeStage(void *arg)
+{
+	struct PlxPipeline *pipeline = (struct PlxPipeline*) arg;
+	struct PlxReader view;
+	struct PlxDecoder decoder;
+	unsigned __int64 start, end;
+	__int64 position = 0;
+
+	// the decode stage reads in file order and reports the progress
+	if (pipeline->stats != NULL) {
+		plxStatsInit(&pipeline->decodeStats, pipeline->stats);
+		pipeline->decodeStats.progressInterval = pipeline->stats->progressInterval;
+		plxStatsBind(&pipeline->decodeStats);
+	}
+
+	if (pipeline->index != NULL) {
+
+		pipeline->bytes = pipeline->reader->dataOffset;
+
+		while (plxIndexNextRange(pipeline->index, &pipeline->options->filter, &position, &start, &end)) {
+
+			plxReaderView(pipeline->reader, &view, start, end);
+			plxDecoderInit(&decoder, &view);
+			decoder.filter = &pipeline->options->filter;
+
+			if (!plxPipeDecode(pipeline, &decoder)) break;
+			pipeline->bytes += end - start;
+		}
+
+	} else {
+
+		plxDecoderInit(&decoder, pipeline->reader);
+		decoder.filter = &pipeline->options->filter;
+
+		plxPipeDecode(pipeline, &decoder);
+		pipeline->bytes = pipeline->reader->offset;
+	}
+
+	plxRingClose(&pipeline->batchRing);
+	return NULL;
+}
+
+// Format stage: collect the rows of batches until a write is big enough
+static void *plxPipeFormatStage(void *arg)
+{
+	struct PlxPipeline *pipeline = (struct PlxPipeline*) arg;
+	struct PlxPipeOut *out = NULL;
+	int frequency = pipeline->reader->fileHeader.ADFrequency;
+	int batchSlot, outSlot;
+
+	if (pipeline->stats != NULL) {
+		plxStatsInit(&pipeline->formatStats, pipeline->stats);
+		plxStatsBind(&pipeline->formatStats);
+	}
+
+	while ((batchSlot = plxRingPeek(&pipeline->batchRing)) >= 0) {
+
+		// the write stage failed, the decode stage stops on its own
+		if (__atomic_load_n(&pipeline->abort, __ATOMIC_RELAXED)) break;
+
+		if (out == NULL) {
+			if ((outSlot = plxRingAcquire(&pipeline->outRing, &pipeline->abort)) < 0) break;
+			out = &pipeline->outs[outSlot];
+			out->out.used = 0;
+			memset(&out->counts, 0, sizeof(struct PlxCounts));
+		}
+
+		plxStatsPhase(plxStatsCurrent(), PLX_PHASE_FORMAT);
+		formatCsvBatch(pipeline->options, &pipeline->batches[batchSlot], frequency, &out->out, &out->counts);
+		plxStatsPhase(plxStatsCurrent(), PLX_PHASE_IDLE);
+		plxRingRelease(&pipeline->batchRing);
+
+		if (out->out.used >= PLX_PIPE_WRITE) {
+			plxRingPublish(&pipeline->outRing);
+			out = NULL;
+		}
+	}
+
+	if ((out != NULL) && !__atomic_load_n(&pipeline->abort, __ATOMIC_RELAXED)) plxRingPublish(&pipeline->outRing);
+	plxRingClose(&pipeline->outRing);
+
+	return NULL;
+}
+
+// Convert data blocks in three stages: a decode thread fills batches, a
+// format thread turns them into csv rows and the calling thread writes
+// them, so reading, formatting and writing overlap. Memory is bounded by
+// the ring slots, which makes it suitable for pipes (stdin/stdout).
+// Falls back to convertCsvSerial() if the threads cannot be started.
+int convertCsvPipeline(struct PlxReader *reader, const struct PlxOptions *options, const struct PlxIndex *index, FILE *csvOutFile, struct PlxCounts *counts)
+{
+	struct PlxPipeline *pipeline;
+	struct PlxPipeOut *out;
+	pthread_t decodeThread, formatThread;
+	int i, slot, phase, started = 0, result = 0;
+
+	pipeline = (struct PlxPipeline*) calloc (1, sizeof(struct PlxPipeline));
+	if (pipeline == NULL) return PLX_ERR_MEMORY;
+
+	pipeline->reader  = reader;
+	pipeline->options = options;
+	pipeline->index   = index;
+	pipeline->stats   = plxStatsCurrent();
+
+	for (i = 0; (result == 0) && (i < PLX_PIPE_SLOTS); i++) {
+		if ((plxBatchAlloc(&pipeline->batches[i], PLX_BATCH_BLOCKS, PLX_BATCH_BLOCKS * reader->fileHeader.NumPointsWave) != 0) ||
+			(plxOutBufInit(&pipeline->outs[i].out, NULL, 2 * PLX_PIPE_WRITE) != 0)) {
+			result = PLX_ERR_MEMORY;
+		}
+	}
+
+	if ((result == 0) && (pthread_create(&decodeThread, NULL, plxPipeDecodeStage, pipeline) == 0)) {
+		started++;
+		if (pthread_create(&formatThread, NULL, plxPipeFormatStage, pipeline) == 0) {
+			started++;
+		} else {
+			// stop the decode stage, nobody consumes its batches
+			__atomic_store_n(&pipeline->abort, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	if (started == 2) {
+
+		// write stage
+		phase = plxStatsPhase(pipeline->stats, PLX_PHASE_IDLE);
+		while ((slot = plxRingPeek(&pipeline->outRing)) >= 0) {
+
+			out = &pipeline->outs[slot];
+
+			plxStatsPhase(pipeline->stats, PLX_PHASE_WRITE);
+			if ((fwrite(out->out.data, 1, out->out.used, csvOutFile) != out->out.used) || out->out.error) {
+				// stop all stages, the remaining slots are not drained
+				__atomic_store_n(&pipeline->abort, 1, __ATOMIC_RELAXED);
+				result = -1;
+				break;
+			}
+			if (pipeline->stats != NULL) pipeline->stats->bytesOut += out->out.used;
+			plxStatsPhase(pipeline->stats, PLX_PHASE_IDLE);
+
+			counts->spikes += out->counts.spikes;
+			counts->events += out->counts.events;
+			counts->slow   += out->counts.slow;
+
+			plxRingRelease(&pipeline->outRing);
+		}
+
+		pthread_join(formatThread, NULL);
+		plxStatsPhase(pipeline->stats, phase);
+	}
+
+	if (started > 0) pthread_join(decodeThread, NULL);
+	if (started == 2) counts->bytes = pipeline->bytes;
+
+	// stage threads end with their phase accounted (IDLE after each batch)
+	if ((started == 2) && (pipeline->stats != NULL)) {
+		plxStatsPhase(&pipeline->decodeStats, PLX_PHASE_IDLE);
+		plxStatsMerge(pipeline->stats, &pipeline->decodeStats);
+		plxStatsMerge(pipeline->stats, &pipeline->formatStats);
+	}
+
+	for (i = 0; i < PLX_PIPE_SLOTS; i++) {
+		plxBatchFree(&pipeline->batches[i]);
+		plxOutBufFree(&pipeline->outs[i].out);
+	}
+	free(pipeline);
+
+	// single threaded if the stages could not be started
+	if ((result == 0) && (started < 2)) {
+		if (started == 1) return PLX_ERR_MEMORY;
+		return convertCsvSerial(reader, options, index, csvOutFile, counts);
+	}
+
+	return result;
+}
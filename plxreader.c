@@ -0,0 +1,365 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "plxreader.h"
+
+// Copy bytes from the current position of the input file
+static int plxReaderRead(struct PlxReader *reader, void *dest, size_t bytes)
+{
+	if (reader->mode == PLX_READER_MMAP) {
+
+		if (reader->offset + bytes > reader->size) return 0;
+		memcpy(dest, reader->map + reader->offset, bytes);
+
+	} else {
+
+		if (fread(dest, 1, bytes, reader->file) != bytes) return 0;
+	}
+
+	reader->offset += bytes;
+	return 1;
+}
+
+// Read the file header followed by the DSP, event and slow channel headers
+static int plxReaderReadHeaders(struct PlxReader *reader)
+{
+	struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	int numDSP, numEvent, numSlow;
+
+	if (!plxReaderRead(reader, fileHeader, sizeof(struct PL_FileHeader))) return PLX_ERR_INVALID;
+
+	// exit if header doesn't have magic number
+	if (fileHeader->MagicNumber != 0x58454C50) return PLX_ERR_INVALID;
+
+	numDSP   = fileHeader->NumDSPChannels;
+	numEvent = fileHeader->NumEventChannels;
+	numSlow  = fileHeader->NumSlowChannels;
+
+	if ((numDSP < 0) || (numEvent < 0) || (numSlow < 0)) return PLX_ERR_INVALID;
+
+	reader->chanHeaders  = (struct PL_ChanHeader*) calloc (numDSP + 1, sizeof(struct PL_ChanHeader));
+	reader->eventHeaders = (struct PL_EventHeader*) calloc (numEvent + 1, sizeof(struct PL_EventHeader));
+	reader->slowHeaders  = (struct PL_SlowChannelHeader*) calloc (numSlow + 1, sizeof(struct PL_SlowChannelHeader));
+
+	if ((reader->chanHeaders == NULL) || (reader->eventHeaders == NULL) || (reader->slowHeaders == NULL)) {
+		return PLX_ERR_MEMORY;
+	}
+
+	if (!plxReaderRead(reader, reader->chanHeaders, numDSP * sizeof(struct PL_ChanHeader)) ||
+		!plxReaderRead(reader, reader->eventHeaders, numEvent * sizeof(struct PL_EventHeader)) ||
+		!plxReaderRead(reader, reader->slowHeaders, numSlow * sizeof(struct PL_SlowChannelHeader))) {
+		return PLX_ERR_INVALID;
+	}
+
+	reader->dataOffset   = reader->offset;
+	reader->adviseOffset = reader->offset;
+	reader->releaseLimit = ~0ULL;
+
+	return 0;
+}
+
+// Map the input file; returns 0 if the file cannot be mapped
+static int plxReaderMap(struct PlxReader *reader, const char *fileName)
+{
+	struct stat st;
+	void *map;
+
+	reader->fd = open(fileName, O_RDONLY);
+	if (reader->fd < 0) return 0;
+
+	if ((fstat(reader->fd, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size == 0)) {
+		close(reader->fd);
+		reader->fd = -1;
+		return 0;
+	}
+
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+	if (map == MAP_FAILED) {
+		close(reader->fd);
+		reader->fd = -1;
+		return 0;
+	}
+
+	// blocks are walked front to back exactly once
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+	reader->map   = (const unsigned char*) map;
+	reader->size  = (unsigned __int64) st.st_size;
+	reader->mtime = (__int64) st.st_mtime;
+
+	return 1;
+}
+
+// Keep read-ahead one window in front of the reader and drop consumed pages
+static void plxReaderAdvise(struct PlxReader *reader)
+{
+	unsigned __int64 page = (unsigned __int64) sysconf(_SC_PAGESIZE);
+	unsigned __int64 start, end;
+
+	if (reader->offset < reader->adviseOffset) return;
+
+	// release the consumed pages behind us (page aligned), blocks still
+	// in use elsewhere are protected by releaseLimit
+	start = reader->releaseOffset;
+	end   = ((reader->offset < reader->releaseLimit) ? reader->offset : reader->releaseLimit) & ~(page - 1);
+	if (end > start) {
+		madvise((void*)(reader->map + start), (size_t)(end - start), MADV_DONTNEED);
+		reader->releaseOffset = end;
+	}
+
+	// prefetch the next window
+	start = reader->offset & ~(page - 1);
+	end   = reader->offset + PLX_READER_WINDOW;
+	if (end > reader->size) end = reader->size;
+	if (end > start) madvise((void*)(reader->map + start), (size_t)(end - start), MADV_WILLNEED);
+
+	reader->adviseOffset = reader->offset + PLX_READER_WINDOW / 2;
+}
+
+int plxReaderOpen(struct PlxReader *reader, const char *fileName, int mode)
+{
+	struct stat st;
+	int result;
+
+	memset(reader, 0, sizeof(struct PlxReader));
+	reader->fd = -1;
+
+	// fall back to stdio if the file cannot be mapped (pipes, devices, ...)
+	if (!strcmp(fileName, "-")) {
+		reader->mode = PLX_READER_STDIO;
+		reader->file = stdin;
+		setvbuf(stdin, NULL, _IOFBF, PLX_READER_PIPE_BUFFER);
+	} else if ((mode == PLX_READER_MMAP) && plxReaderMap(reader, fileName)) {
+		reader->mode = PLX_READER_MMAP;
+	} else {
+		reader->mode = PLX_READER_STDIO;
+		reader->file = fopen(fileName, "rb");
+		if (reader->file == NULL) return PLX_ERR_OPEN;
+
+		if ((fstat(fileno(reader->file), &st) == 0) && S_ISREG(st.st_mode)) {
+			reader->size  = (unsigned __int64) st.st_size;
+			reader->mtime = (__int64) st.st_mtime;
+		}
+	}
+
+	result = plxReaderReadHeaders(reader);
+	if (result != 0) {
+		plxReaderClose(reader);
+		return result;
+	}
+
+	return 0;
+}
+
+// Get the header of the next data block. Returns 1 if a header is
+// available, 0 at the end of the file. Its waveform has to be consumed
+// with plxReaderPayload() or plxReaderSkip() before the next call.
+int plxReaderNextHeader(struct PlxReader *reader, struct PL_DataBlockHeader *header)
+{
+	size_t bytes;
+
+	if (reader->mode == PLX_READER_MMAP) {
+
+		if (reader->offset + sizeof(struct PL_DataBlockHeader) > reader->size) {
+			reader->truncated = (reader->offset != reader->size);
+			return 0;
+		}
+		memcpy(header, reader->map + reader->offset, sizeof(struct PL_DataBlockHeader));
+		reader->offset += sizeof(struct PL_DataBlockHeader);
+
+	} else {
+
+		bytes = fread(header, 1, sizeof(struct PL_DataBlockHeader), reader->file);
+		if (bytes != sizeof(struct PL_DataBlockHeader)) {
+			reader->truncated = (bytes != 0);
+			return 0;
+		}
+		reader->offset += bytes;
+	}
+
+	// block header is followed by NumberOfWaveforms*NumberOfWordsInWaveform shorts
+	reader->payloadBytes = 0;
+	if ((header->NumberOfWaveforms > 0) && (header->NumberOfWordsInWaveform > 0)) {
+		reader->payloadBytes = (unsigned __int64) header->NumberOfWaveforms * header->NumberOfWordsInWaveform * sizeof(short);
+	}
+
+	return 1;
+}
+
+// Check that the waveform of a mapped block is complete. An incomplete
+// block is not consumed, i.e. offset stays at its header.
+static int plxReaderMapped(struct PlxReader *reader)
+{
+	if (reader->offset + reader->payloadBytes > reader->size) {
+		reader->offset      -= sizeof(struct PL_DataBlockHeader);
+		reader->payloadBytes = 0;
+		reader->truncated    = 1;
+		return 0;
+	}
+
+	return 1;
+}
+
+// Get the waveform of the block returned by plxReaderNextHeader(). The
+// pointer stays valid until the next call.
+int plxReaderPayload(struct PlxReader *reader, const short **ppWaveform)
+{
+	unsigned __int64 bytes = reader->payloadBytes;
+
+	if (reader->mode == PLX_READER_MMAP) {
+
+		if (!plxReaderMapped(reader)) return 0;
+		reader->payloadBytes = 0;
+
+		*ppWaveform = (const short*)(reader->map + reader->offset);
+		reader->offset += bytes;
+
+		plxReaderAdvise(reader);
+
+	} else {
+
+		reader->payloadBytes = 0;
+
+		// grow waveform buffer if necessary
+		if (bytes > (unsigned __int64) reader->bufferWords * sizeof(short)) {
+			free(reader->buffer);
+			reader->buffer = (short*) malloc (bytes);
+			if (reader->buffer == NULL) {
+				reader->bufferWords = 0;
+				return 0;
+			}
+			reader->bufferWords = (int)(bytes / sizeof(short));
+		}
+
+		// an incomplete block is not consumed, see plxReaderMapped()
+		if (!plxReaderRead(reader, reader->buffer, bytes)) {
+			reader->offset   -= sizeof(struct PL_DataBlockHeader);
+			reader->truncated = 1;
+			return 0;
+		}
+
+		*ppWaveform = reader->buffer;
+	}
+
+	return 1;
+}
+
+// Step over the waveform of the block returned by plxReaderNextHeader()
+// without reading it. Pipes fall back to reading.
+int plxReaderSkip(struct PlxReader *reader)
+{
+	const short *pWaveform;
+	unsigned __int64 bytes = reader->payloadBytes;
+
+	if (reader->mode == PLX_READER_MMAP) {
+
+		if (!plxReaderMapped(reader)) return 0;
+		reader->payloadBytes = 0;
+		reader->offset += bytes;
+
+		plxReaderAdvise(reader);
+
+	} else if (reader->size > 0) {
+
+		reader->payloadBytes = 0;
+		if (reader->offset + bytes > reader->size) {
+			reader->offset   -= sizeof(struct PL_DataBlockHeader);
+			reader->truncated = 1;
+			return 0;
+		}
+		if ((bytes > 0) && (fseeko(reader->file, (off_t) bytes, SEEK_CUR) != 0)) return 0;
+		reader->offset += bytes;
+
+	} else {
+
+		return plxReaderPayload(reader, &pWaveform);
+	}
+
+	return 1;
+}
+
+// Get the next data block. Returns 1 and fills header and waveform pointer
+// if a complete block is available, 0 at the end of the file. The waveform
+// pointer stays valid until the next call.
+int plxReaderNext(struct PlxReader *reader, struct PL_DataBlockHeader *header, const short **ppWaveform)
+{
+	if (!plxReaderNextHeader(reader, header)) return 0;
+
+	return plxReaderPayload(reader, ppWaveform);
+}
+
+// Continue reading at the data block at offset
+int plxReaderSeek(struct PlxReader *reader, unsigned __int64 offset)
+{
+	if (reader->mode == PLX_READER_MMAP) {
+		if (offset > reader->size) return PLX_ERR_INVALID;
+	} else if (offset != reader->offset) {
+		// streams (stdin) cannot seek, but may already be at the offset
+		if (fseeko(reader->file, (off_t) offset, SEEK_SET) != 0) return PLX_ERR_INVALID;
+	}
+
+	reader->offset       = offset;
+	reader->adviseOffset = offset;
+	reader->truncated    = 0;
+	reader->payloadBytes = 0;
+
+	return 0;
+}
+
+// Create a view on the blocks in [start, end) of a mapped reader. Views
+// share the mapping and headers with their parent, give no madvise hints
+// and must not be closed.
+void plxReaderView(const struct PlxReader *reader, struct PlxReader *view, unsigned __int64 start, unsigned __int64 end)
+{
+	*view = *reader;
+
+	view->offset       = start;
+	view->size         = end;
+	view->adviseOffset = ~0ULL;
+	view->truncated    = 0;
+	view->buffer       = NULL;
+	view->bufferWords  = 0;
+}
+
+void plxReaderClose(struct PlxReader *reader)
+{
+	if (reader->map != NULL) munmap((void*) reader->map, (size_t) reader->size);
+	if (reader->fd >= 0) close(reader->fd);
+	if ((reader->file != NULL) && (reader->file != stdin)) fclose(reader->file);
+
+	free(reader->buffer);
+	free(reader->chanHeaders);
+	free(reader->eventHeaders);
+	free(reader->slowHeaders);
+
+	memset(reader, 0, sizeof(struct PlxReader));
+	reader->fd = -1;
+}
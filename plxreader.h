@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXREADER_H__
+#define __PLXREADER_H__
+
+#ifdef __GNUC__
+#ifndef __int64
+#define __int64 long long
+#endif
+#endif
+
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Plexon.h"
+
+// Reader backends
+#define PLX_READER_MMAP		0	// map the whole file and walk blocks in place
+#define PLX_READER_STDIO	1	// classic fread path (also used for pipes)
+
+// Reader error codes
+#define PLX_ERR_OPEN		-1	// cannot open or map input file
+#define PLX_ERR_INVALID		-2	// missing magic number or truncated headers
+#define PLX_ERR_MEMORY		-3	// out of memory
+
+// stdio buffer for reading from stdin (bytes)
+#define PLX_READER_PIPE_BUFFER	(1 << 20)
+
+// Sequential access window for madvise hints (bytes)
+#define PLX_READER_WINDOW	(64 << 20)
+
+// Plexon file reader. Parses the file and channel headers on open and then
+// hands out data blocks one by one. With the mmap backend the waveform
+// pointer returned by plxReaderNext() points straight into the mapping,
+// i.e. blocks are never copied. plxReaderNextHeader() reads a block header
+// only; its waveform is then either fetched with plxReaderPayload() or
+// stepped over with plxReaderSkip() without reading it. The file name "-"
+// reads from stdin.
+struct PlxReader
+{
+	int 	mode;						// PLX_READER_MMAP or PLX_READER_STDIO
+	int 	fd;							// mmap backend file descriptor
+	FILE 	*file;						// stdio backend file pointer
+
+	const unsigned char *map;			// mapped file (mmap backend)
+	unsigned __int64 size;				// file size in bytes
+	__int64 	mtime;					// file modification time
+	unsigned __int64 dataOffset;		// offset of the first data block
+	unsigned __int64 offset;			// offset of the next data block
+	unsigned __int64 adviseOffset;		// end of the last madvise window
+	unsigned __int64 releaseOffset;		// end of the pages released behind the reader
+	unsigned __int64 releaseLimit;		// pages before it may be released (~0: all consumed pages)
+	int 	truncated;					// last block was incomplete
+	unsigned __int64 payloadBytes;		// waveform bytes behind the last header not consumed yet
+
+	short 	*buffer;					// waveform buffer (stdio backend)
+	int 	bufferWords;				// capacity of buffer in shorts
+
+	// headers
+	struct PL_FileHeader 		fileHeader;
+	struct PL_ChanHeader 		*chanHeaders;
+	struct PL_EventHeader 		*eventHeaders;
+	struct PL_SlowChannelHeader	*slowHeaders;
+};
+
+// Reader functions
+int  plxReaderOpen(struct PlxReader *reader, const char *fileName, int mode);
+int  plxReaderNext(struct PlxReader *reader, struct PL_DataBlockHeader *header, const short **ppWaveform);
+int  plxReaderNextHeader(struct PlxReader *reader, struct PL_DataBlockHeader *header);
+int  plxReaderPayload(struct PlxReader *reader, const short **ppWaveform);
+int  plxReaderSkip(struct PlxReader *reader);
+int  plxReaderSeek(struct PlxReader *reader, unsigned __int64 offset);
+void plxReaderView(const struct PlxReader *reader, struct PlxReader *view, unsigned __int64 start, unsigned __int64 end);
+void plxReaderClose(struct PlxReader *reader);
+
+#endif
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+#include "plxresume.h"
+
+// FNV-1a, start with hash = 2166136261
+unsigned int plxResumeHash(unsigned int hash, const void *data, size_t bytes)
+{
+	const unsigned char *p = (const unsigned char*) data;
+	size_t i;
+
+	for (i = 0; i < bytes; i++) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+// Header fields up to the acquisition time; counters and LastTimestamp
+// may be rewritten when the recording stops
+static unsigned int plxResumeFileStamp(const struct PlxReader *reader)
+{
+	return plxResumeHash(2166136261u, &reader->fileHeader, offsetof(struct PL_FileHeader, FastRead));
+}
+
+// Checkpoint of a new output, starting at the first data block
+void plxResumeInit(struct PlxResume *resume, const struct PlxReader *reader, unsigned int optionStamp)
+{
+	memset(resume, 0, sizeof(struct PlxResume));
+
+	resume->magic       = PLX_RESUME_MAGIC;
+	resume->version     = PLX_RESUME_VERSION;
+	resume->fileStamp   = plxResumeFileStamp(reader);
+	resume->optionStamp = optionStamp;
+	resume->dataOffset  = reader->dataOffset;
+	resume->offset      = reader->dataOffset;
+}
+
+// Load the checkpoint of the plx file opened by reader. Returns
+// PLX_ERR_INVALID if it belongs to another file or other options, or if
+// the file is shorter than the checkpoint (the recording was restarted).
+int plxResumeLoad(struct PlxResume *resume, const char *fileName, const struct PlxReader *reader, unsigned int optionStamp)
+{
+	FILE *resumeFile;
+	int result;
+
+	resumeFile = fopen(fileName, "rb");
+	if (resumeFile == NULL) return PLX_ERR_OPEN;
+
+	result = (fread(resume, sizeof(struct PlxResume), 1, resumeFile) == 1) ? 0 : PLX_ERR_INVALID;
+	fclose(resumeFile);
+
+	if ((result != 0) ||
+		(resume->magic != PLX_RESUME_MAGIC) ||
+		(resume->version != PLX_RESUME_VERSION) ||
+		(resume->fileStamp != plxResumeFileStamp(reader)) ||
+		(resume->optionStamp != optionStamp) ||
+		(resume->dataOffset != reader->dataOffset) ||
+		(resume->offset < reader->dataOffset) ||
+		(resume->offset > reader->size)) {
+		return PLX_ERR_INVALID;
+	}
+
+	return 0;
+}
+
+// Replace the checkpoint file as a whole, so an interrupted save leaves
+// the previous one
+int plxResumeSave(const struct PlxResume *resume, const char *fileName)
+{
+	char tmpFileName[1024];
+	FILE *resumeFile;
+	int result = 0;
+
+	snprintf(tmpFileName, sizeof(tmpFileName), "%s.tmp", fileName);
+
+	resumeFile = fopen(tmpFileName, "wb");
+	if (resumeFile == NULL) return PLX_ERR_OPEN;
+
+	if (fwrite(resume, sizeof(struct PlxResume), 1, resumeFile) != 1) result = PLX_ERR_OPEN;
+	if (fclose(resumeFile) != 0) result = PLX_ERR_OPEN;
+
+	if ((result == 0) && (rename(tmpFileName, fileName) != 0)) result = PLX_ERR_OPEN;
+	if (result != 0) remove(tmpFileName);
+
+	return result;
+}
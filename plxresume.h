@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXRESUME_H__
+#define __PLXRESUME_H__
+
+#pragma once
+#include "plxreader.h"
+
+#define PLX_RESUME_MAGIC	0x53525850	// "PXRS"
+#define PLX_RESUME_VERSION	1
+
+// Checkpoint of an incremental conversion (-resume, -follow), saved next
+// to the output file. A run seeks to offset, cuts the output back to
+// outputSize (rows of an interrupted run) and appends the rows of the
+// blocks written since.
+struct PlxResume
+{
+	unsigned int 		magic;			// = PLX_RESUME_MAGIC
+	int 				version;		// = PLX_RESUME_VERSION
+	unsigned int 		fileStamp;		// hash of the file header fields fixed at the start of a recording
+	unsigned int 		optionStamp;	// hash of the options that shape the rows
+	unsigned __int64 	dataOffset;		// offset of the first data block
+	unsigned __int64 	offset;			// offset behind the last complete data block converted
+	unsigned __int64 	outputSize;		// output bytes written up to offset
+	__int64 			spikes;			// rows written up to offset
+	__int64 			events;
+	__int64 			slow;
+	__int64 			runs;			// conversions so far, 0 for a new output
+};
+
+// Resume functions
+unsigned int plxResumeHash(unsigned int hash, const void *data, size_t bytes);
+void plxResumeInit(struct PlxResume *resume, const struct PlxReader *reader, unsigned int optionStamp);
+int  plxResumeLoad(struct PlxResume *resume, const char *fileName, const struct PlxReader *reader, unsigned int optionStamp);
+int  plxResumeSave(const struct PlxResume *resume, const char *fileName);
+
+#endif
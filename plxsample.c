@@ -0,0 +1,273 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxsample.h"
+#include "plxstats.h"
+
+// Slot of a reservoir with its timestamp, for writing in time order
+struct PlxSampleOrder
+{
+	__int64 	timestamp;
+	int 		slot;
+};
+
+void plxSampleInit(struct PlxSample *sample, const struct PlxReader *reader, int size, unsigned __int64 seed)
+{
+	memset(sample, 0, sizeof(struct PlxSample));
+	sample->size  = (size > 0) ? size : 1;
+	sample->width = (reader->fileHeader.NumPointsWave > 0) ? reader->fileHeader.NumPointsWave : 1;
+
+	// splitmix64 of the seed, the generator state must not be 0
+	seed += 0x9E3779B97F4A7C15ULL;
+	seed  = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	seed  = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+	seed ^= seed >> 31;
+	sample->random = (seed != 0) ? seed : 1;
+}
+
+// xorshift64*
+static unsigned __int64 plxSampleRandom(struct PlxSample *sample)
+{
+	sample->random ^= sample->random >> 12;
+	sample->random ^= sample->random << 25;
+	sample->random ^= sample->random >> 27;
+	return sample->random * 0x2545F4914F6CDD1DULL;
+}
+
+// Reservoir of channel and unit, created on first use. NULL if out of memory.
+static struct PlxSampleUnit *plxSampleGet(struct PlxSample *sample, int channel, int unit)
+{
+	struct PlxSampleUnit *entry, *resized;
+	int i, direct;
+
+	direct = (channel >= 0) && (channel < PLX_SAMPLE_CHANNELS) && (unit >= 0) && (unit < PLX_SAMPLE_UNITS);
+
+	if (direct) {
+		if (sample->lookup[channel][unit] > 0) return &sample->units[sample->lookup[channel][unit] - 1];
+	} else {
+		for (i = 0; i < sample->numUnits; i++) {
+			if ((sample->units[i].channel == channel) && (sample->units[i].unit == unit)) return &sample->units[i];
+		}
+	}
+
+	if (sample->numUnits == sample->capacity) {
+		resized = (struct PlxSampleUnit*) realloc (sample->units, (sample->capacity + 64) * sizeof(struct PlxSampleUnit));
+		if (resized == NULL) return NULL;
+		sample->units     = resized;
+		sample->capacity += 64;
+	}
+
+	entry = &sample->units[sample->numUnits++];
+	memset(entry, 0, sizeof(struct PlxSampleUnit));
+	entry->channel = (short) channel;
+	entry->unit    = (short) unit;
+
+	if (direct) sample->lookup[channel][unit] = sample->numUnits;
+
+	return entry;
+}
+
+// Make room for one more waveform in a reservoir that is not full yet
+static int plxSampleGrow(struct PlxSample *sample, struct PlxSampleUnit *unit)
+{
+	__int64 *timestamps;
+	short *numWaveforms, *numWords, *samples;
+	int slots;
+
+	if (unit->count < unit->slots) return 0;
+
+	slots = (unit->slots > 0) ? 2 * unit->slots : PLX_SAMPLE_MIN_SLOTS;
+	if (slots > sample->size) slots = sample->size;
+
+	timestamps = (__int64*) realloc (unit->timestamps, slots * sizeof(__int64));
+	if (timestamps != NULL) unit->timestamps = timestamps;
+	numWaveforms = (short*) realloc (unit->numWaveforms, slots * sizeof(short));
+	if (numWaveforms != NULL) unit->numWaveforms = numWaveforms;
+	numWords = (short*) realloc (unit->numWords, slots * sizeof(short));
+	if (numWords != NULL) unit->numWords = numWords;
+	samples = (short*) realloc (unit->samples, (size_t) slots * sample->width * sizeof(short));
+	if (samples != NULL) unit->samples = samples;
+
+	if ((timestamps == NULL) || (numWaveforms == NULL) || (numWords == NULL) || (samples == NULL)) return PLX_ERR_MEMORY;
+
+	unit->slots = slots;
+	return 0;
+}
+
+// Offer every spike block of the reader (that passes filter) to the
+// reservoir of its unit. Spike k of a unit takes a random slot with
+// probability size/k; only then its waveform is read.
+int plxSampleRead(struct PlxSample *sample, struct PlxReader *reader, const struct PlxFilter *filter)
+{
+	struct PL_DataBlockHeader header;
+	struct PlxStats *stats = plxStatsCurrent();
+	struct PlxSampleUnit *unit = NULL;
+	const short *pWaveform;
+	__int64 slot;
+	int words, phase;
+
+	phase = plxStatsPhase(stats, PLX_PHASE_DECODE);
+
+	while (!sample->error && plxReaderNextHeader(reader, &header)) {
+
+		if (stats != NULL) {
+			plxStatsBlock(stats, &header);
+			if ((stats->blocks & 4095) == 0) plxStatsProgress(stats, reader->offset);
+		}
+
+		if ((header.Type != 1) || ((filter != NULL) && !plxFilterMatch(filter, &header))) {
+			if (!plxReaderSkip(reader)) break;
+			continue;
+		}
+
+		// spikes of a unit often come in runs
+		if ((unit == NULL) || (unit->channel != header.Channel) || (unit->unit != header.Unit)) {
+			unit = plxSampleGet(sample, header.Channel, header.Unit);
+			if (unit == NULL) {
+				sample->error = 1;
+				break;
+			}
+		}
+
+		unit->seen++;
+		sample->spikes++;
+
+		// the first size spikes fill the reservoir, later ones replace a random slot
+		slot = (unit->seen <= sample->size) ? unit->seen - 1 : (__int64)(plxSampleRandom(sample) % (unsigned __int64) unit->seen);
+
+		if (slot >= sample->size) {
+			if (!plxReaderSkip(reader)) break;
+			continue;
+		}
+
+		if ((slot == unit->count) && (plxSampleGrow(sample, unit) != 0)) {
+			sample->error = 1;
+			break;
+		}
+
+		if (!plxReaderPayload(reader, &pWaveform)) break;
+		sample->payloads++;
+
+		words = ((header.NumberOfWaveforms > 0) && (header.NumberOfWordsInWaveform > 0)) ? header.NumberOfWordsInWaveform : 0;
+		if (words > sample->width) words = sample->width;
+
+		unit->timestamps[slot]   = (((__int64)(header.UpperByteOf5ByteTimestamp))<<32) + (__int64)(header.TimeStamp);
+		unit->numWaveforms[slot] = header.NumberOfWaveforms;
+		unit->numWords[slot]     = (short) words;
+		if (words > 0) memcpy(&unit->samples[slot * sample->width], pWaveform, words * sizeof(short));
+
+		if (slot == unit->count) unit->count++;
+	}
+
+	plxStatsProgress(stats, reader->offset);
+	plxStatsPhase(stats, phase);
+
+	return sample->error ? PLX_ERR_MEMORY : 0;
+}
+
+static int plxSampleCompareUnits(const void *a, const void *b)
+{
+	const struct PlxSampleUnit *x = (const struct PlxSampleUnit*) a, *y = (const struct PlxSampleUnit*) b;
+
+	if (x->channel != y->channel) return x->channel - y->channel;
+	return x->unit - y->unit;
+}
+
+static int plxSampleCompareOrder(const void *a, const void *b)
+{
+	const struct PlxSampleOrder *x = (const struct PlxSampleOrder*) a, *y = (const struct PlxSampleOrder*) b;
+
+	if (x->timestamp != y->timestamp) return (x->timestamp > y->timestamp) - (x->timestamp < y->timestamp);
+	return x->slot - y->slot;
+}
+
+// Write the sampled waveforms as csv rows (like plxFormatCsvRow), sorted by
+// channel, unit and time. No spikes can be offered afterwards.
+int plxSampleWrite(struct PlxSample *sample, struct PlxOutBuf *out, int frequency, const struct PlxScaleTable *scale)
+{
+	struct PlxSampleUnit *unit;
+	struct PlxSampleOrder *order;
+	struct PlxBatch row;
+	short type = 1;
+	int i, k, start = 0;
+
+	qsort(sample->units, sample->numUnits, sizeof(struct PlxSampleUnit), plxSampleCompareUnits);
+	memset(sample->lookup, 0, sizeof(sample->lookup));
+
+	// one block view per waveform
+	memset(&row, 0, sizeof(struct PlxBatch));
+	row.capacity    = 1;
+	row.count       = 1;
+	row.type        = &type;
+	row.sampleStart = &start;
+
+	for (i = 0; i < sample->numUnits; i++) {
+
+		unit = &sample->units[i];
+
+		order = (struct PlxSampleOrder*) malloc ((unit->count + 1) * sizeof(struct PlxSampleOrder));
+		if (order == NULL) return PLX_ERR_MEMORY;
+
+		for (k = 0; k < unit->count; k++) {
+			order[k].timestamp = unit->timestamps[k];
+			order[k].slot      = k;
+		}
+		qsort(order, unit->count, sizeof(struct PlxSampleOrder), plxSampleCompareOrder);
+
+		row.channel = &unit->channel;
+		row.unit    = &unit->unit;
+
+		for (k = 0; k < unit->count; k++) {
+			row.timestamp    = &unit->timestamps[order[k].slot];
+			row.numWaveforms = &unit->numWaveforms[order[k].slot];
+			row.numWords     = &unit->numWords[order[k].slot];
+			row.samples      = &unit->samples[order[k].slot * sample->width];
+			row.numSamples   = *row.numWords;
+
+			if (scale != NULL) plxFormatCsvRowScaled(out, &row, 0, frequency, scale);
+			else plxFormatCsvRow(out, &row, 0, frequency);
+		}
+
+		free(order);
+	}
+
+	return out->error ? -1 : 0;
+}
+
+void plxSampleFree(struct PlxSample *sample)
+{
+	int i;
+
+	for (i = 0; i < sample->numUnits; i++) {
+		free(sample->units[i].timestamps);
+		free(sample->units[i].numWaveforms);
+		free(sample->units[i].numWords);
+		free(sample->units[i].samples);
+	}
+	free(sample->units);
+
+	memset(sample, 0, sizeof(struct PlxSample));
+}
@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXSAMPLE_H__
+#define __PLXSAMPLE_H__
+
+#pragma once
+#include "plxscale.h"
+
+// Direct lookup of (channel, unit), reservoirs outside of it are searched
+#define PLX_SAMPLE_CHANNELS		256
+#define PLX_SAMPLE_UNITS		32
+
+// Initial number of waveforms of a reservoir, grown up to the sample size
+#define PLX_SAMPLE_MIN_SLOTS	64
+
+// Reservoir of one channel and unit
+struct PlxSampleUnit
+{
+	short 		channel;
+	short 		unit;
+	__int64 	seen;					// spikes offered
+	int 		count;					// waveforms held
+	int 		slots;					// waveforms allocated
+	__int64 	*timestamps;
+	short 		*numWaveforms;
+	short 		*numWords;				// samples held per waveform (first waveform, at most width)
+	short 		*samples;				// slots x width
+};
+
+// Uniform sample of up to size spike waveforms per channel and unit
+// (-sample), drawn in one pass by reservoir sampling (algorithm R). The
+// decision is made from the block header, so only the waveforms that enter
+// a reservoir are read; all other payloads are skipped. The random numbers
+// come from a seeded xorshift64* generator, the same seed draws the same
+// sample.
+struct PlxSample
+{
+	struct PlxSampleUnit *units;
+	int 		numUnits;
+	int 		capacity;
+	int 		lookup[PLX_SAMPLE_CHANNELS][PLX_SAMPLE_UNITS];	// index + 1 into units, 0: none yet
+	int 		size;					// waveforms per unit
+	int 		width;					// samples kept per waveform (NumPointsWave)
+	unsigned __int64 random;		// generator state
+	__int64 	spikes;					// spikes offered
+	__int64 	payloads;				// waveforms read
+	int 		error;					// out of memory
+};
+
+// Sample functions
+void plxSampleInit(struct PlxSample *sample, const struct PlxReader *reader, int size, unsigned __int64 seed);
+int  plxSampleRead(struct PlxSample *sample, struct PlxReader *reader, const struct PlxFilter *filter);
+int  plxSampleWrite(struct PlxSample *sample, struct PlxOutBuf *out, int frequency, const struct PlxScaleTable *scale);
+void plxSampleFree(struct PlxSample *sample);
+
+#endif
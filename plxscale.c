@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PLX_SCALE_X86
+#endif
+
+#include "plxscale.h"
+
+// Microvolts per ADC unit
+static float plxScaleFactor(const struct PL_FileHeader *fileHeader, int gain)
+{
+	int bits = fileHeader->BitsPerSpikeSample;
+	double maxMV = fileHeader->SpikeMaxMagnitudeMV;
+	double preAmpGain = fileHeader->SpikePreAmpGain;
+
+	if (fileHeader->Version < 103) {
+		bits  = 12;
+		maxMV = 3000;
+	}
+	if ((fileHeader->Version < 105) || (preAmpGain <= 0)) preAmpGain = 1000;
+
+	if ((bits <= 0) || (bits > 31)) bits = 12;
+	if (maxMV <= 0) maxMV = 3000;
+	if (gain <= 0) gain = 1;
+
+	return (float)(maxMV * 1000.0 / ((double)(1 << (bits - 1)) * gain * preAmpGain));
+}
+
+int plxScaleTableInit(struct PlxScaleTable *table, const struct PlxReader *reader)
+{
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	int i, channel;
+
+	memset(table, 0, sizeof(struct PlxScaleTable));
+
+	table->defaultScale = plxScaleFactor(fileHeader, 1);
+
+	table->maxChannel = -1;
+	for (i = 0; i < fileHeader->NumDSPChannels; i++) {
+		if (reader->chanHeaders[i].Channel > table->maxChannel) table->maxChannel = reader->chanHeaders[i].Channel;
+	}
+
+	table->scale = (float*) malloc ((table->maxChannel + 2) * sizeof(float));
+	if (table->scale == NULL) return PLX_ERR_MEMORY;
+
+	for (i = 0; i <= table->maxChannel; i++) table->scale[i] = table->defaultScale;
+
+	for (i = 0; i < fileHeader->NumDSPChannels; i++) {
+		channel = reader->chanHeaders[i].Channel;
+		if (channel >= 0) table->scale[channel] = plxScaleFactor(fileHeader, reader->chanHeaders[i].Gain);
+	}
+
+	return 0;
+}
+
+float plxScaleGet(const struct PlxScaleTable *table, int channel)
+{
+	if ((channel < 0) || (channel > table->maxChannel)) return table->defaultScale;
+
+	return table->scale[channel];
+}
+
+void plxScaleTableFree(struct PlxScaleTable *table)
+{
+	free(table->scale);
+	memset(table, 0, sizeof(struct PlxScaleTable));
+}
+
+static void plxScaleSamplesGeneric(float *dst, const short *src, int count, float scale)
+{
+	int i;
+
+	for (i = 0; i < count; i++) dst[i] = (float) src[i] * scale;
+}
+
+#ifdef PLX_SCALE_X86
+
+__attribute__((target("sse2")))
+static void plxScaleSamplesSSE2(float *dst, const short *src, int count, float scale)
+{
+	__m128 factor = _mm_set1_ps(scale);
+	__m128i raw, low, high;
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		raw  = _mm_loadu_si128((const __m128i*)(src + i));
+
+		// sign extend 16 -> 32 bit
+		low  = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+		high = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+
+		_mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_cvtepi32_ps(low), factor));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), factor));
+	}
+
+	plxScaleSamplesGeneric(dst + i, src + i, count - i, scale);
+}
+
+__attribute__((target("avx2")))
+static void plxScaleSamplesAVX2(float *dst, const short *src, int count, float scale)
+{
+	__m256 factor = _mm256_set1_ps(scale);
+	__m256i low, high;
+	int i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		low  = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+		high = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i + 8)));
+
+		_mm256_storeu_ps(dst + i,     _mm256_mul_ps(_mm256_cvtepi32_ps(low), factor));
+		_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(high), factor));
+	}
+
+	plxScaleSamplesSSE2(dst + i, src + i, count - i, scale);
+}
+
+#endif
+
+void plxScaleSamples(float *dst, const short *src, int count, float scale)
+{
+#ifdef PLX_SCALE_X86
+	// the cpu features are detected once at startup by libgcc
+	if (__builtin_cpu_supports("avx2")) {
+		plxScaleSamplesAVX2(dst, src, count, scale);
+	} else if (__builtin_cpu_supports("sse2")) {
+		plxScaleSamplesSSE2(dst, src, count, scale);
+	} else {
+		plxScaleSamplesGeneric(dst, src, count, scale);
+	}
+#else
+	plxScaleSamplesGeneric(dst, src, count, scale);
+#endif
+}
+
+// Like sprintf("%.2f"), rounded to 0.01 in double precision; zero is never
+// signed
+char *plxFormatMicrovolts(char *p, float value)
+{
+	long long hundredths = llrint((double) value * 100.0);
+	int fraction;
+
+	if ((hundredths > 200000000000LL) || (hundredths < -200000000000LL) || (value != value)) {
+		return p + sprintf(p, "%.2f", value);
+	}
+
+	if (hundredths < 0) {
+		*p++ = '-';
+		hundredths = -hundredths;
+	}
+
+	fraction = (int)(hundredths % 100);
+	p = plxFormatInt(p, (int)(hundredths / 100));
+
+	*p++ = '.';
+	*p++ = (char)('0' + fraction / 10);
+	*p++ = (char)('0' + fraction % 10);
+
+	return p;
+}
+
+// Same as plxFormatCsvRow() with the waveform samples in microvolts
+void plxFormatCsvRowScaled(struct PlxOutBuf *out, const struct PlxBatch *batch, int index, int frequency, const struct PlxScaleTable *table)
+{
+	float scaled[PLX_SCALE_CHUNK];
+	const short *pWaveform;
+	float scale = plxScaleGet(table, batch->channel[index]);
+	int i, n, done, words = 0;
+	char *p;
+
+	if ((batch->numWaveforms[index] == 1) && (batch->numWords[index] > 0)) {
+		words = batch->numWords[index];
+	}
+
+	// longest fields: seconds 330 (printf fallback), scaled samples 48 characters each
+	p = plxOutBufReserve(out, 352 + 48 * (size_t) words);
+	if (p == NULL) return;
+
+	p = plxFormatSeconds(p, batch->timestamp[index], frequency);
+	*p++ = ',';
+	p = plxFormatInt(p, batch->channel[index]);
+	*p++ = ',';
+	p = plxFormatInt(p, batch->unit[index]);
+	*p++ = ',';
+
+	if (words > 0) {
+		pWaveform = &batch->samples[batch->sampleStart[index]];
+		for (done = 0; done < words; done += n) {
+			n = (words - done > PLX_SCALE_CHUNK) ? PLX_SCALE_CHUNK : words - done;
+			plxScaleSamples(scaled, pWaveform + done, n, scale);
+			for (i = 0; i < n; i++) {
+				p = plxFormatMicrovolts(p, scaled[i]);
+				*p++ = ',';
+			}
+		}
+		p[-1] = '\n';
+	}
+
+	out->used = p - out->data;
+}
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXSCALE_H__
+#define __PLXSCALE_H__
+
+#pragma once
+#include "plxformat.h"
+
+// Samples converted per step when formatting scaled rows
+#define PLX_SCALE_CHUNK		256
+
+// Spike waveform scale factors (raw ADC value -> microvolts) per DSP
+// channel, derived from the file header and the channel gains following
+// the version rules of the plx format:
+//   Version < 103:  12 bits, 3000 mV, gain = actual gain / 1000
+//   Version < 105:  BitsPerSpikeSample, SpikeMaxMagnitudeMV, preamp gain 1000
+//   Version >= 105: BitsPerSpikeSample, SpikeMaxMagnitudeMV, SpikePreAmpGain
+struct PlxScaleTable
+{
+	float 	*scale;						// indexed by channel number
+	float 	defaultScale;				// channels without header (gain 1)
+	int 	maxChannel;
+};
+
+// Scale table functions
+int   plxScaleTableInit(struct PlxScaleTable *table, const struct PlxReader *reader);
+float plxScaleGet(const struct PlxScaleTable *table, int channel);
+void  plxScaleTableFree(struct PlxScaleTable *table);
+
+// dst[i] = src[i] * scale, vectorized (SSE2/AVX2 chosen at run time)
+void  plxScaleSamples(float *dst, const short *src, int count, float scale);
+
+// Number formatting and CSV rows with scaled waveform samples
+char *plxFormatMicrovolts(char *p, float value);
+void  plxFormatCsvRowScaled(struct PlxOutBuf *out, const struct PlxBatch *batch, int index, int frequency, const struct PlxScaleTable *table);
+
+#endif
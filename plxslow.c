@@ -0,0 +1,233 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxslow.h"
+
+int plxSlowOpen(struct PlxSlowWriter *writer, const struct PlxReader *reader, const char *baseName, int format)
+{
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	int i, channel;
+
+	memset(writer, 0, sizeof(struct PlxSlowWriter));
+
+	if (fileHeader->ADFrequency <= 0) return PLX_ERR_INVALID;
+
+	writer->format      = format;
+	writer->frequency   = fileHeader->ADFrequency;
+	writer->baseName    = baseName;
+	writer->numChannels = fileHeader->NumSlowChannels;
+
+	// channel numbers are 0-based
+	writer->maxChannel = -1;
+	for (i = 0; i < writer->numChannels; i++) {
+		if (reader->slowHeaders[i].Channel > writer->maxChannel) writer->maxChannel = reader->slowHeaders[i].Channel;
+	}
+
+	writer->channels = (struct PlxSlowChannel*) calloc (writer->numChannels + 1, sizeof(struct PlxSlowChannel));
+	writer->lookup   = (int*) malloc ((writer->maxChannel + 2) * sizeof(int));
+
+	if ((writer->channels == NULL) || (writer->lookup == NULL)) {
+		plxSlowClose(writer);
+		return PLX_ERR_MEMORY;
+	}
+
+	for (i = 0; i <= writer->maxChannel; i++) writer->lookup[i] = -1;
+
+	for (i = 0; i < writer->numChannels; i++) {
+		writer->channels[i].header = &reader->slowHeaders[i];
+		channel = reader->slowHeaders[i].Channel;
+		if ((channel >= 0) && (reader->slowHeaders[i].ADFreq > 0)) writer->lookup[channel] = i;
+	}
+
+	return 0;
+}
+
+// Open output file of a channel when its first block arrives
+static int plxSlowStart(struct PlxSlowWriter *writer, struct PlxSlowChannel *slow, __int64 timestamp)
+{
+	char fileName[1024];
+
+	snprintf(fileName, sizeof(fileName), "%s.slow%03d.%s", writer->baseName, slow->header->Channel,
+		(writer->format == PLX_FORMAT_BIN) ? "bin" : "csv");
+
+	slow->file = fopen(fileName, (writer->format == PLX_FORMAT_BIN) ? "wb" : "w");
+	if ((slow->file == NULL) || (plxOutBufInit(&slow->out, slow->file, PLX_SLOW_OUTBUF_SIZE) != 0)) {
+		writer->error = 1;
+		return 0;
+	}
+
+	slow->firstTimestamp = timestamp;
+
+	if (writer->format == PLX_FORMAT_CSV) {
+		fprintf(slow->file, "# Channel %d (%.32s), ADFreq=%d\n", slow->header->Channel, slow->header->Name, slow->header->ADFreq);
+		fprintf(slow->file, "# Time (Seconds); Value\n");
+	}
+
+	return 1;
+}
+
+// Append samples (NULL for gap fill) to the stream of a channel
+static void plxSlowWrite(struct PlxSlowWriter *writer, struct PlxSlowChannel *slow, const short *pSamples, __int64 count)
+{
+	__int64 ticks, scale = (__int64) writer->frequency * slow->header->ADFreq;
+	__int64 i, n, chunk;
+	char *p;
+
+	// keep each reservation within the channel buffer
+	chunk = (writer->format == PLX_FORMAT_BIN) ? PLX_SLOW_OUTBUF_SIZE / sizeof(short) : PLX_SLOW_OUTBUF_SIZE / 352;
+
+	while (count > 0) {
+
+		n = (count > chunk) ? chunk : count;
+
+		if (writer->format == PLX_FORMAT_BIN) {
+
+			p = plxOutBufReserve(&slow->out, n * sizeof(short));
+			if (p == NULL) return;
+
+			if (pSamples != NULL) memcpy(p, pSamples, n * sizeof(short));
+			else memset(p, 0, n * sizeof(short));
+			slow->out.used += n * sizeof(short);
+
+		} else {
+
+			// seconds + ',' + value + '\n' (printf fallback for odd frequencies)
+			p = plxOutBufReserve(&slow->out, n * 352);
+			if (p == NULL) return;
+
+			for (i = 0; i < n; i++) {
+
+				// sample time: firstTimestamp + k / ADFreq seconds
+				ticks = slow->firstTimestamp * slow->header->ADFreq + (slow->numSamples + i) * writer->frequency;
+				p = plxFormatFixed6(p, (double) ticks / (double) scale);
+				*p++ = ',';
+				if (pSamples != NULL) p = plxFormatInt(p, pSamples[i]);
+				*p++ = '\n';
+			}
+			slow->out.used = p - slow->out.data;
+		}
+
+		slow->numSamples += n;
+		if (pSamples != NULL) pSamples += n;
+		count -= n;
+	}
+}
+
+// Append all A/D blocks of a batch to their channel streams
+void plxSlowBatch(struct PlxSlowWriter *writer, const struct PlxBatch *batch)
+{
+	struct PlxSlowChannel *slow;
+	const short *pSamples;
+	__int64 position, words, skip;
+	int j, channel;
+
+	for (j = 0; j < batch->count; j++) {
+
+		if (batch->type[j] != 5) continue;
+
+		channel = batch->channel[j];
+		if ((channel < 0) || (channel > writer->maxChannel) || (writer->lookup[channel] < 0)) {
+			writer->unknownBlocks++;
+			continue;
+		}
+		slow = &writer->channels[writer->lookup[channel]];
+
+		if ((slow->file == NULL) && !plxSlowStart(writer, slow, batch->timestamp[j])) continue;
+
+		pSamples = &batch->samples[batch->sampleStart[j]];
+		words    = (batch->numWaveforms[j] > 0) && (batch->numWords[j] > 0) ? (__int64) batch->numWaveforms[j] * batch->numWords[j] : 0;
+
+		// oversized blocks are truncated by the decoder
+		if (words > batch->numSamples - batch->sampleStart[j]) words = batch->numSamples - batch->sampleStart[j];
+
+		// sample position of the block in the channel stream (rounded)
+		position = ((batch->timestamp[j] - slow->firstTimestamp) * slow->header->ADFreq + writer->frequency / 2) / writer->frequency;
+
+		if (position > slow->numSamples) {
+
+			// fill gap explicitly
+			slow->numGaps++;
+			slow->gapSamples += position - slow->numSamples;
+			plxSlowWrite(writer, slow, NULL, position - slow->numSamples);
+
+		} else if (position < slow->numSamples) {
+
+			// drop samples that were already written
+			skip = slow->numSamples - position;
+			if (skip > words) skip = words;
+
+			slow->overlapSamples += skip;
+			pSamples += skip;
+			words    -= skip;
+		}
+
+		plxSlowWrite(writer, slow, pSamples, words);
+		if (slow->out.error) writer->error = 1;
+	}
+}
+
+// Flush and close all channel files and write the channel summary file
+int plxSlowClose(struct PlxSlowWriter *writer)
+{
+	struct PlxSlowChannel *slow;
+	char fileName[1024];
+	FILE *summaryFile = NULL;
+	int i;
+
+	if ((writer->channels != NULL) && (writer->baseName != NULL)) {
+		snprintf(fileName, sizeof(fileName), "%s.slow.csv", writer->baseName);
+		summaryFile = fopen(fileName, "w");
+		if (summaryFile == NULL) writer->error = 1;
+		else fprintf(summaryFile, "Channel,Name,ADFreq,Start (Seconds),Samples,Gaps,GapSamples,OverlapSamples\n");
+	}
+
+	for (i = 0; (writer->channels != NULL) && (i < writer->numChannels); i++) {
+
+		slow = &writer->channels[i];
+		if (slow->file == NULL) continue;
+
+		plxOutBufFree(&slow->out);
+		if (fclose(slow->file) != 0) writer->error = 1;
+		if (slow->out.error) writer->error = 1;
+		slow->file = NULL;
+
+		if (summaryFile != NULL) {
+			fprintf(summaryFile, "%d,%.32s,%d,%.6f,%lld,%lld,%lld,%lld\n",
+				slow->header->Channel, slow->header->Name, slow->header->ADFreq,
+				(double) slow->firstTimestamp / (double) writer->frequency,
+				slow->numSamples, slow->numGaps, slow->gapSamples, slow->overlapSamples);
+		}
+	}
+
+	if ((summaryFile != NULL) && (fclose(summaryFile) != 0)) writer->error = 1;
+
+	free(writer->channels);
+	free(writer->lookup);
+	writer->channels = NULL;
+	writer->lookup   = NULL;
+
+	return writer->error ? -1 : 0;
+}
@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXSLOW_H__
+#define __PLXSLOW_H__
+
+#pragma once
+#include "plxformat.h"
+
+// Output buffer per continuous channel (bytes)
+#define PLX_SLOW_OUTBUF_SIZE	(64 << 10)
+
+// Reassembly state of one continuous channel
+struct PlxSlowChannel
+{
+	const struct PL_SlowChannelHeader *header;
+	FILE 				*file;				// opened with the first block
+	struct PlxOutBuf 	out;
+	__int64 			firstTimestamp;		// timestamp of the first sample in ticks
+	__int64 			numSamples;			// samples written including gap fill
+	__int64 			numGaps;			// number of gaps between blocks
+	__int64 			gapSamples;			// samples filled in gaps
+	__int64 			overlapSamples;		// samples dropped because blocks overlapped
+};
+
+// Writer for continuous channels. A/D blocks of each channel are joined
+// into one contiguous sample stream at the channel's ADFreq; gaps between
+// blocks are filled (empty CSV values, zero binary samples), so sample k
+// always belongs to firstTimestamp + k / ADFreq seconds.
+struct PlxSlowWriter
+{
+	int 					format;			// PLX_FORMAT_CSV or PLX_FORMAT_BIN
+	int 					frequency;		// timestamp frequency (ADFrequency)
+	const char 				*baseName;		// output file name prefix
+	struct PlxSlowChannel 	*channels;		// one per slow channel header
+	int 					numChannels;
+	int 					*lookup;		// channel number -> index in channels
+	int 					maxChannel;
+	__int64 				unknownBlocks;	// blocks without slow channel header
+	int 					error;
+};
+
+// Slow channel functions
+int  plxSlowOpen(struct PlxSlowWriter *writer, const struct PlxReader *reader, const char *baseName, int format);
+void plxSlowBatch(struct PlxSlowWriter *writer, const struct PlxBatch *batch);
+int  plxSlowClose(struct PlxSlowWriter *writer);
+
+#endif
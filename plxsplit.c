@@ -0,0 +1,231 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <sys/resource.h>
+
+#include "plxsplit.h"
+#include "plxstats.h"
+
+// Descriptors left for the input, index and standard files
+#define PLX_SPLIT_RESERVED_FILES	32
+
+static unsigned int plxSplitHash(unsigned int key, int numSlots)
+{
+	return (key * 2654435761u) & (unsigned int)(numSlots - 1);
+}
+
+// Rebuild the hash table with numSlots slots (power of two)
+static int plxSplitRehash(struct PlxSplitWriter *writer, int numSlots)
+{
+	unsigned int slot;
+	int *slots, i;
+
+	slots = (int*) malloc (numSlots * sizeof(int));
+	if (slots == NULL) return PLX_ERR_MEMORY;
+
+	for (i = 0; i < numSlots; i++) slots[i] = -1;
+
+	for (i = 0; i < writer->numOutputs; i++) {
+		slot = plxSplitHash(writer->outputs[i].key, numSlots);
+		while (slots[slot] >= 0) slot = (slot + 1) & (unsigned int)(numSlots - 1);
+		slots[slot] = i;
+	}
+
+	free(writer->slots);
+	writer->slots    = slots;
+	writer->numSlots = numSlots;
+
+	return 0;
+}
+
+int plxSplitOpen(struct PlxSplitWriter *writer, const char *baseName, int mode, const char *header)
+{
+	struct rlimit limit;
+
+	memset(writer, 0, sizeof(struct PlxSplitWriter));
+
+	writer->mode     = mode;
+	writer->baseName = baseName;
+	writer->header   = header;
+
+	// stay well below the descriptor limit of the process
+	writer->maxOpen = PLX_SPLIT_MAX_FILES;
+	if ((getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur != RLIM_INFINITY)) {
+		if (limit.rlim_cur < (rlim_t)(PLX_SPLIT_MAX_FILES + PLX_SPLIT_RESERVED_FILES)) writer->maxOpen = (int) limit.rlim_cur - PLX_SPLIT_RESERVED_FILES;
+	}
+	if (writer->maxOpen < 1) writer->maxOpen = 1;
+
+	return plxSplitRehash(writer, 256);
+}
+
+// Find the output of a key, creating it on first use
+static struct PlxSplitOutput *plxSplitFind(struct PlxSplitWriter *writer, unsigned int key)
+{
+	struct PlxSplitOutput *outputs, *output;
+	unsigned int slot;
+	int capacity;
+
+	slot = plxSplitHash(key, writer->numSlots);
+	while (writer->slots[slot] >= 0) {
+		if (writer->outputs[writer->slots[slot]].key == key) return &writer->outputs[writer->slots[slot]];
+		slot = (slot + 1) & (unsigned int)(writer->numSlots - 1);
+	}
+
+	if (writer->numOutputs == writer->capacity) {
+		capacity = (writer->capacity > 0) ? 2 * writer->capacity : 64;
+		outputs  = (struct PlxSplitOutput*) realloc (writer->outputs, capacity * sizeof(struct PlxSplitOutput));
+		if (outputs == NULL) return NULL;
+		writer->outputs  = outputs;
+		writer->capacity = capacity;
+	}
+
+	output = &writer->outputs[writer->numOutputs];
+	memset(output, 0, sizeof(struct PlxSplitOutput));
+	output->key = key;
+
+	if (plxOutBufInit(&output->out, NULL, PLX_SPLIT_OUTBUF_SIZE) != 0) return NULL;
+
+	writer->slots[slot] = writer->numOutputs++;
+
+	// keep the table at most half full
+	if ((2 * writer->numOutputs > writer->numSlots) && (plxSplitRehash(writer, 2 * writer->numSlots) != 0)) {
+		writer->numOutputs--;
+		free(output->out.data);
+		return NULL;
+	}
+
+	return output;
+}
+
+// Write the buffer of an output to its file, opening (and evicting) files
+// as needed
+static void plxSplitFlush(struct PlxSplitWriter *writer, struct PlxSplitOutput *output)
+{
+	struct PlxSplitOutput *oldest = NULL;
+	struct PlxStats *stats = plxStatsCurrent();
+	char fileName[1024];
+	int i, phase;
+
+	if (output->out.used == 0) return;
+
+	phase = plxStatsPhase(stats, PLX_PHASE_WRITE);
+
+	if (output->file == NULL) {
+
+		// close the least recently written file
+		if (writer->numOpen >= writer->maxOpen) {
+			for (i = 0; i < writer->numOutputs; i++) {
+				if ((writer->outputs[i].file != NULL) && ((oldest == NULL) || (writer->outputs[i].lastUse < oldest->lastUse))) oldest = &writer->outputs[i];
+			}
+			if (oldest != NULL) {
+				if (fclose(oldest->file) != 0) writer->error = 1;
+				oldest->file = NULL;
+				writer->numOpen--;
+			}
+		}
+
+		if (writer->mode == PLX_SPLIT_UNIT) {
+			snprintf(fileName, sizeof(fileName), "%s.ch%03u.u%02u.csv", writer->baseName, output->key >> 16, output->key & 0xFFFF);
+		} else {
+			snprintf(fileName, sizeof(fileName), "%s.ch%03u.csv", writer->baseName, output->key >> 16);
+		}
+
+		output->file = fopen(fileName, output->created ? "a" : "w");
+		if (output->file == NULL) {
+			writer->error = 1;
+			output->out.used = 0;
+			plxStatsPhase(stats, phase);
+			return;
+		}
+		writer->numOpen++;
+
+		// the buffer already batches the rows
+		setvbuf(output->file, NULL, _IONBF, 0);
+
+		if (output->created) {
+			writer->reopens++;
+		} else {
+			output->created = 1;
+			if (writer->header != NULL) fputs(writer->header, output->file);
+		}
+	}
+
+	if (fwrite(output->out.data, 1, output->out.used, output->file) != output->out.used) writer->error = 1;
+	if (stats != NULL) stats->bytesOut += output->out.used;
+	plxStatsPhase(stats, phase);
+
+	output->out.bytesWritten += output->out.used;
+	output->out.used = 0;
+	output->lastUse  = ++writer->flushes;
+}
+
+// Get the buffer of a channel/unit with room for bytes. The pointer is
+// valid until the next call.
+struct PlxOutBuf *plxSplitReserve(struct PlxSplitWriter *writer, int channel, int unit, size_t bytes)
+{
+	struct PlxSplitOutput *output;
+	unsigned int key = (unsigned int)(unsigned short) channel << 16;
+
+	if (writer->mode == PLX_SPLIT_UNIT) key |= (unsigned short) unit;
+
+	output = plxSplitFind(writer, key);
+	if (output == NULL) {
+		writer->error = 1;
+		return NULL;
+	}
+
+	if (output->out.used + bytes > output->out.size) plxSplitFlush(writer, output);
+
+	return &output->out;
+}
+
+int plxSplitClose(struct PlxSplitWriter *writer)
+{
+	struct PlxSplitOutput *output;
+	int i;
+
+	for (i = 0; i < writer->numOutputs; i++) {
+
+		output = &writer->outputs[i];
+
+		plxSplitFlush(writer, output);
+		if (output->out.error) writer->error = 1;
+
+		if (output->file != NULL) {
+			if (fclose(output->file) != 0) writer->error = 1;
+			output->file = NULL;
+			writer->numOpen--;
+		}
+		free(output->out.data);
+	}
+
+	free(writer->outputs);
+	free(writer->slots);
+	writer->outputs = NULL;
+	writer->slots   = NULL;
+
+	return writer->error ? -1 : 0;
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXSPLIT_H__
+#define __PLXSPLIT_H__
+
+#pragma once
+#include "plxformat.h"
+
+// Split modes
+#define PLX_SPLIT_NONE			0
+#define PLX_SPLIT_CHANNEL		1	// one file per channel
+#define PLX_SPLIT_UNIT			2	// one file per channel and unit
+
+// Output buffer per split file (bytes)
+#define PLX_SPLIT_OUTBUF_SIZE	(128 << 10)
+
+// Upper limit of files kept open at the same time
+#define PLX_SPLIT_MAX_FILES		256
+
+// One split output file. The buffer is not attached to the file, so it
+// only ever grows for single rows larger than the buffer; the writer
+// hands it to the file when it is full.
+struct PlxSplitOutput
+{
+	unsigned int 		key;			// channel << 16 | unit
+	FILE 				*file;			// NULL while closed
+	int 				created;		// file was created (reopen for append)
+	__int64 			lastUse;		// flush counter at the last write (LRU)
+	struct PlxOutBuf 	out;
+};
+
+// Fan-out writer routing rows to one file per channel (or channel/unit).
+// Every output owns a buffer, but at most maxOpen files are open: when a
+// full buffer must be written and no descriptor is free, the least
+// recently written file is closed and reopened for append later.
+struct PlxSplitWriter
+{
+	int 					mode;			// PLX_SPLIT_CHANNEL or PLX_SPLIT_UNIT
+	const char 				*baseName;		// output file name prefix
+	const char 				*header;		// first line of every file or NULL
+	struct PlxSplitOutput 	*outputs;
+	int 					numOutputs;
+	int 					capacity;
+	int 					*slots;			// hash table key -> index in outputs (-1: empty)
+	int 					numSlots;
+	int 					numOpen;		// open files
+	int 					maxOpen;
+	__int64 				flushes;
+	__int64 				reopens;		// files reopened after eviction
+	int 					error;
+};
+
+// Split writer functions
+int  plxSplitOpen(struct PlxSplitWriter *writer, const char *baseName, int mode, const char *header);
+struct PlxOutBuf *plxSplitReserve(struct PlxSplitWriter *writer, int channel, int unit, size_t bytes);
+int  plxSplitClose(struct PlxSplitWriter *writer);
+
+#endif
@@ -0,0 +1,258 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include <sys/resource.h>
+
+#include "plxstats.h"
+#include "plxsummary.h"
+
+// Stats of the calling thread or NULL
+static __thread struct PlxStats *plxStatsThread;
+
+static const char *plxStatsPhaseNames[PLX_PHASES] = { "headers", "decode", "format", "write" };
+
+static double plxStatsSeconds(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Clear all counters; the progress settings are taken from config (may
+// be NULL) without its progress interval, so only one thread of a
+// conversion prints progress lines unless the caller enables it again
+void plxStatsInit(struct PlxStats *stats, const struct PlxStats *config)
+{
+	memset(stats, 0, sizeof(struct PlxStats));
+
+	if (config != NULL) {
+		stats->json     = config->json;
+		stats->fileName = config->fileName;
+		stats->size     = config->size;
+	}
+
+	stats->phase = PLX_PHASE_IDLE;
+	clock_gettime(CLOCK_MONOTONIC, &stats->start);
+	stats->lastProgress = stats->start;
+}
+
+void plxStatsBind(struct PlxStats *stats)
+{
+	plxStatsThread = stats;
+}
+
+struct PlxStats *plxStatsCurrent(void)
+{
+	return plxStatsThread;
+}
+
+// Account the time since the last switch to the current phase and
+// continue with phase. Returns the previous phase so callers can switch
+// back. Does nothing without stats.
+int plxStatsPhase(struct PlxStats *stats, int phase)
+{
+	struct timespec wall, cpu;
+	int previous;
+
+	if (stats == NULL) return PLX_PHASE_IDLE;
+
+	previous = stats->phase;
+	if (previous == phase) return previous;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+
+	if (previous < PLX_PHASES) {
+		stats->wall[previous] += plxStatsSeconds(&stats->wallStart, &wall);
+		stats->cpu[previous]  += plxStatsSeconds(&stats->cpuStart, &cpu);
+	}
+
+	stats->phase     = phase;
+	stats->wallStart = wall;
+	stats->cpuStart  = cpu;
+
+	return previous;
+}
+
+// Count a data block header in the type and waveform length histograms
+void plxStatsBlock(struct PlxStats *stats, const struct PL_DataBlockHeader *header)
+{
+	int words = 0, bucket = 0;
+
+	stats->blocks++;
+
+	if ((header->Type >= 0) && (header->Type < PLX_STATS_TYPES)) stats->types[header->Type]++;
+	else stats->otherTypes++;
+
+	if ((header->NumberOfWaveforms > 0) && (header->NumberOfWordsInWaveform > 0)) {
+		words = header->NumberOfWaveforms * header->NumberOfWordsInWaveform;
+	}
+
+	// bucket k > 0 holds 2^(k-2) < words <= 2^(k-1)
+	if (words > 0) {
+		bucket = 1;
+		while ((bucket < PLX_STATS_WAVE_BUCKETS - 1) && (words > (1 << (bucket - 1)))) bucket++;
+	}
+	stats->waveLengths[bucket]++;
+}
+
+// Print a progress line with rate and estimated time left once per
+// progressInterval seconds
+void plxStatsProgress(struct PlxStats *stats, unsigned __int64 offset)
+{
+	struct timespec now;
+	double elapsed, rate, eta = -1;
+
+	if ((stats == NULL) || (stats->progressInterval <= 0)) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (plxStatsSeconds(&stats->lastProgress, &now) < stats->progressInterval) return;
+	stats->lastProgress = now;
+
+	elapsed = plxStatsSeconds(&stats->start, &now);
+	rate    = (elapsed > 0) ? offset / elapsed : 0;
+	if ((stats->size > 0) && (rate > 0) && (offset <= stats->size)) eta = (stats->size - offset) / rate;
+
+	if (stats->json) {
+		// one line per report, even with several conversions writing to stderr
+		flockfile(stderr);
+		fprintf(stderr, "{\"file\": ");
+		plxSummaryString(stderr, stats->fileName, -1);
+		fprintf(stderr, ", \"bytes\": %llu, \"size\": %llu, \"progress\": %.4f, \"mbPerSecond\": %.1f, \"elapsed\": %.3f, \"eta\": %.1f}\n",
+			offset, stats->size, (stats->size > 0) ? (double) offset / stats->size : 0.0, rate / 1e6, elapsed, eta);
+		funlockfile(stderr);
+	} else if (stats->size > 0) {
+		fprintf(stderr, " %s: %5.1f%% (%.1f of %.1f MB, %.1f MB/s, %.1f s left)\n",
+			stats->fileName, 100.0 * offset / stats->size, offset / 1e6, stats->size / 1e6, rate / 1e6, eta);
+	} else {
+		fprintf(stderr, " %s: %.1f MB (%.1f MB/s)\n", stats->fileName, offset / 1e6, rate / 1e6);
+	}
+}
+
+// Add the counters of another thread of the same conversion
+void plxStatsMerge(struct PlxStats *stats, const struct PlxStats *other)
+{
+	int i;
+
+	for (i = 0; i < PLX_PHASES; i++) {
+		stats->wall[i] += other->wall[i];
+		stats->cpu[i]  += other->cpu[i];
+	}
+	for (i = 0; i < PLX_STATS_TYPES; i++) stats->types[i] += other->types[i];
+	for (i = 0; i < PLX_STATS_WAVE_BUCKETS; i++) stats->waveLengths[i] += other->waveLengths[i];
+
+	stats->bytesOut   += other->bytesOut;
+	stats->blocks     += other->blocks;
+	stats->otherTypes += other->otherTypes;
+}
+
+// Smallest number of words of a waveform length bucket
+static int plxStatsBucketMin(int bucket)
+{
+	if (bucket <= 2) return bucket;
+	return (1 << (bucket - 2)) + 1;
+}
+
+// Write the report as json or text. Peak memory is that of the process.
+void plxStatsWrite(FILE *file, const struct PlxStats *stats, double elapsed)
+{
+	struct rusage usage;
+	double cpu;
+	int i, first;
+
+	getrusage(RUSAGE_SELF, &usage);
+	cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+
+	if (stats->json) {
+
+		fprintf(file, "{\n");
+		fprintf(file, "  \"file\": ");
+		plxSummaryString(file, stats->fileName, -1);
+		fprintf(file, ",\n");
+		fprintf(file, "  \"elapsed\": %.6f,\n", elapsed);
+		fprintf(file, "  \"processCpu\": %.6f,\n", cpu);
+		fprintf(file, "  \"bytesIn\": %llu,\n", stats->bytesIn);
+		fprintf(file, "  \"bytesOut\": %llu,\n", stats->bytesOut);
+		fprintf(file, "  \"blocks\": %lld,\n", stats->blocks);
+		fprintf(file, "  \"mbPerSecond\": %.3f,\n", (elapsed > 0) ? stats->bytesIn / 1e6 / elapsed : 0.0);
+		fprintf(file, "  \"blocksPerSecond\": %.1f,\n", (elapsed > 0) ? stats->blocks / elapsed : 0.0);
+		fprintf(file, "  \"peakRssKB\": %ld,\n", usage.ru_maxrss);
+
+		fprintf(file, "  \"phases\": {");
+		for (i = 0; i < PLX_PHASES; i++) {
+			fprintf(file, "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}", (i > 0) ? ", " : "", plxStatsPhaseNames[i], stats->wall[i], stats->cpu[i]);
+		}
+		fprintf(file, "},\n");
+
+		fprintf(file, "  \"blockTypes\": {");
+		for (i = 0, first = 1; i < PLX_STATS_TYPES; i++) {
+			if (stats->types[i] == 0) continue;
+			fprintf(file, "%s\"%d\": %lld", first ? "" : ", ", i, stats->types[i]);
+			first = 0;
+		}
+		fprintf(file, "%s\"other\": %lld},\n", first ? "" : ", ", stats->otherTypes);
+
+		fprintf(file, "  \"waveformWords\": [");
+		for (i = 0, first = 1; i < PLX_STATS_WAVE_BUCKETS; i++) {
+			if (stats->waveLengths[i] == 0) continue;
+			if (i == PLX_STATS_WAVE_BUCKETS - 1) {
+				fprintf(file, "%s{\"min\": %d, \"max\": null, \"blocks\": %lld}", first ? "" : ", ", plxStatsBucketMin(i), stats->waveLengths[i]);
+			} else {
+				fprintf(file, "%s{\"min\": %d, \"max\": %d, \"blocks\": %lld}", first ? "" : ", ", plxStatsBucketMin(i), (i > 0) ? 1 << (i - 1) : 0, stats->waveLengths[i]);
+			}
+			first = 0;
+		}
+		fprintf(file, "]\n}\n");
+
+	} else {
+
+		fprintf(file, " Stats:\n");
+		fprintf(file, "  %-10s %10s %10s\n", "phase", "wall (s)", "cpu (s)");
+		for (i = 0; i < PLX_PHASES; i++) {
+			fprintf(file, "  %-10s %10.3f %10.3f\n", plxStatsPhaseNames[i], stats->wall[i], stats->cpu[i]);
+		}
+		fprintf(file, "  %-10s %10.3f %10.3f (process)\n", "total", elapsed, cpu);
+		fprintf(file, "  in %.1f MB, out %.1f MB, %lld blocks (%.1f MB/s, %.0f blocks/s)\n",
+			stats->bytesIn / 1e6, stats->bytesOut / 1e6, stats->blocks,
+			(elapsed > 0) ? stats->bytesIn / 1e6 / elapsed : 0.0, (elapsed > 0) ? stats->blocks / elapsed : 0.0);
+
+		fprintf(file, "  block types:");
+		for (i = 0; i < PLX_STATS_TYPES; i++) {
+			if (stats->types[i] > 0) fprintf(file, " %d=%lld", i, stats->types[i]);
+		}
+		if (stats->otherTypes > 0) fprintf(file, " other=%lld", stats->otherTypes);
+		fprintf(file, "\n");
+
+		fprintf(file, "  waveform words:");
+		for (i = 0; i < PLX_STATS_WAVE_BUCKETS; i++) {
+			if (stats->waveLengths[i] == 0) continue;
+			if (i == PLX_STATS_WAVE_BUCKETS - 1) fprintf(file, " %d+=%lld", plxStatsBucketMin(i), stats->waveLengths[i]);
+			else if (plxStatsBucketMin(i) == ((i > 0) ? 1 << (i - 1) : 0)) fprintf(file, " %d=%lld", plxStatsBucketMin(i), stats->waveLengths[i]);
+			else fprintf(file, " %d-%d=%lld", plxStatsBucketMin(i), 1 << (i - 1), stats->waveLengths[i]);
+		}
+		fprintf(file, "\n");
+
+		fprintf(file, "  peak memory %.1f MB\n", usage.ru_maxrss / 1024.0);
+	}
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXSTATS_H__
+#define __PLXSTATS_H__
+
+#pragma once
+#include <time.h>
+
+#include "plxreader.h"
+
+// Conversion phases
+#define PLX_PHASE_HEADERS		0	// file, channel headers and block index
+#define PLX_PHASE_DECODE		1	// block headers and waveforms into batches
+#define PLX_PHASE_FORMAT		2	// batches into rows or columns
+#define PLX_PHASE_WRITE			3	// output buffers to files
+#define PLX_PHASES				4
+#define PLX_PHASE_IDLE			4	// waiting or not measured
+
+// Histogram shapes
+#define PLX_STATS_TYPES			8	// block types 0..7
+#define PLX_STATS_WAVE_BUCKETS	14	// 0, 1, 2, 3-4, 5-8, ..., 2049 and more words
+
+// Performance counters of one conversion (-stats). A PlxStats is bound to
+// the thread that runs a conversion stage; the decoder, plxOutBufFlush()
+// and the writers then report to it without further plumbing. Time spent
+// in a phase is measured as wall and thread cpu time and summed over the
+// threads of a conversion.
+struct PlxStats
+{
+	int 		phase;								// current phase
+	struct timespec wallStart;						// start of the current phase
+	struct timespec cpuStart;
+	double 		wall[PLX_PHASES];					// seconds per phase
+	double 		cpu[PLX_PHASES];
+
+	unsigned __int64 bytesIn;						// input bytes
+	unsigned __int64 bytesOut;						// bytes written
+	__int64 	blocks;								// data block headers read
+	__int64 	types[PLX_STATS_TYPES];				// blocks per type
+	__int64 	otherTypes;							// blocks of unknown type
+	__int64 	waveLengths[PLX_STATS_WAVE_BUCKETS];	// blocks per waveform length (words)
+
+	// progress lines on stderr
+	double 		progressInterval;					// seconds between lines, 0 for none
+	int 		json;								// progress and report as json
+	const char 	*fileName;
+	unsigned __int64 size;							// input size, 0 if unknown (pipes)
+	struct timespec start;
+	struct timespec lastProgress;
+};
+
+// Stats functions
+void plxStatsInit(struct PlxStats *stats, const struct PlxStats *config);
+void plxStatsBind(struct PlxStats *stats);
+struct PlxStats *plxStatsCurrent(void);
+int  plxStatsPhase(struct PlxStats *stats, int phase);
+void plxStatsBlock(struct PlxStats *stats, const struct PL_DataBlockHeader *header);
+void plxStatsProgress(struct PlxStats *stats, unsigned __int64 offset);
+void plxStatsMerge(struct PlxStats *stats, const struct PlxStats *other);
+void plxStatsWrite(FILE *file, const struct PlxStats *stats, double elapsed);
+
+#endif
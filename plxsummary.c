@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxsummary.h"
+
+// Stream all block headers, skipping the waveforms, and count the blocks
+// like the file header counters do
+int plxSummaryVerify(struct PlxSummaryVerify *verify, struct PlxReader *reader)
+{
+	struct PL_DataBlockHeader header;
+	__int64 timestamp, samples;
+	int channel, unit;
+
+	memset(verify, 0, sizeof(struct PlxSummaryVerify));
+	verify->firstTimestamp = -1;
+
+	if (plxReaderSeek(reader, reader->dataOffset) != 0) return PLX_ERR_INVALID;
+
+	while (plxReaderNextHeader(reader, &header)) {
+
+		samples = (__int64)(reader->payloadBytes / sizeof(short));
+		if (!plxReaderSkip(reader)) break;
+
+		timestamp = (((__int64)(header.UpperByteOf5ByteTimestamp))<<32) + (__int64)(header.TimeStamp);
+		if (verify->firstTimestamp < 0) verify->firstTimestamp = timestamp;
+		if (timestamp > verify->lastTimestamp) verify->lastTimestamp = timestamp;
+
+		verify->blocks++;
+		channel = header.Channel;
+		unit    = header.Unit;
+
+		if (header.Type == 1) {
+
+			verify->spikes++;
+			if ((channel >= 0) && (channel < PLX_SUMMARY_CHANNELS) && (unit >= 0) && (unit < PLX_SUMMARY_UNITS)) {
+				verify->tsCounts[channel][unit]++;
+				if (header.NumberOfWaveforms > 0) verify->wfCounts[channel][unit] += header.NumberOfWaveforms;
+			}
+
+		} else if (header.Type == 4) {
+
+			verify->events++;
+			if ((channel >= 0) && (channel < PLX_SUMMARY_EVENTS)) verify->evCounts[channel]++;
+
+		} else if (header.Type == 5) {
+
+			verify->slowBlocks++;
+			verify->slowSamples += samples;
+			if ((channel >= 0) && (PLX_SUMMARY_SLOW_BASE + channel < PLX_SUMMARY_EVENTS)) verify->evCounts[PLX_SUMMARY_SLOW_BASE + channel] += samples;
+		}
+	}
+
+	verify->truncated = reader->truncated;
+
+	return 0;
+}
+
+// Write text as JSON string, at most maxLength characters (not always
+// terminated) or all of it with a negative maxLength
+void plxSummaryString(FILE *file, const char *text, int maxLength)
+{
+	int i;
+
+	fputc('"', file);
+	for (i = 0; ((maxLength < 0) || (i < maxLength)) && (text[i] != '\0'); i++) {
+		if ((text[i] == '"') || (text[i] == '\\')) fprintf(file, "\\%c", text[i]);
+		else if ((unsigned char) text[i] < 0x20) fprintf(file, "\\u%04x", (unsigned char) text[i]);
+		else fputc(text[i], file);
+	}
+	fputc('"', file);
+}
+
+// Write a header name (at most 32 characters) as JSON string
+static void plxSummaryName(FILE *file, const char *name)
+{
+	plxSummaryString(file, name, 32);
+}
+
+static void plxSummaryMismatch(FILE *file, int *first, const char *counter, int channel, int unit, __int64 header, __int64 blocks)
+{
+	fprintf(file, "%s\n      {\"counter\": \"%s\", \"channel\": %d, ", *first ? "" : ",", counter, channel);
+	if (unit >= 0) fprintf(file, "\"unit\": %d, ", unit);
+	fprintf(file, "\"header\": %lld, \"blocks\": %lld}", header, blocks);
+	*first = 0;
+}
+
+// Write the inventory of a plx file as JSON: header counters per channel
+// and unit, channel names and, with verify, the counts found in the blocks
+void plxSummaryWrite(FILE *file, const struct PlxReader *reader, const char *fileName, const struct PlxSummaryVerify *verify)
+{
+	const struct PL_FileHeader *fileHeader = &reader->fileHeader;
+	const struct PL_ChanHeader *chanHeader;
+	const struct PL_EventHeader *eventHeader;
+	const struct PL_SlowChannelHeader *slowHeader;
+	__int64 total, spikes = 0, events = 0;
+	int i, unit, channel, first, firstUnit;
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"file\": ");
+	plxSummaryString(file, fileName, -1);
+	fprintf(file, ",\n  \"version\": %d,\n", fileHeader->Version);
+	fprintf(file, "  \"date\": \"%4d-%02d-%02d %02d:%02d:%02d\",\n", fileHeader->Year, fileHeader->Month, fileHeader->Day,
+		fileHeader->Hour, fileHeader->Minute, fileHeader->Second);
+	fprintf(file, "  \"fileSize\": %llu,\n", reader->size);
+	fprintf(file, "  \"adFrequency\": %d,\n", fileHeader->ADFrequency);
+	fprintf(file, "  \"lastTimestamp\": %.0f,\n", fileHeader->LastTimestamp);
+	fprintf(file, "  \"duration\": %.6f,\n", (fileHeader->ADFrequency > 0) ? fileHeader->LastTimestamp / fileHeader->ADFrequency : 0.0);
+	fprintf(file, "  \"numPointsWave\": %d,\n", fileHeader->NumPointsWave);
+
+	// spike channels with the counters of the first 4 units
+	fprintf(file, "  \"spikeChannels\": [");
+	for (i = 0; i < fileHeader->NumDSPChannels; i++) {
+
+		chanHeader = &reader->chanHeaders[i];
+		channel    = chanHeader->Channel;
+
+		fprintf(file, "%s\n    {\"channel\": %d, \"name\": ", (i > 0) ? "," : "", channel);
+		plxSummaryName(file, chanHeader->Name);
+		fprintf(file, ", \"gain\": %d, \"units\": [", chanHeader->Gain);
+
+		total = 0;
+		firstUnit = 1;
+		for (unit = 0; (channel > 0) && (channel < PLX_SUMMARY_CHANNELS) && (unit < PLX_SUMMARY_UNITS); unit++) {
+			if ((fileHeader->TSCounts[channel][unit] == 0) && (fileHeader->WFCounts[channel][unit] == 0)) continue;
+			fprintf(file, "%s{\"unit\": %d, \"timestamps\": %d, \"waveforms\": %d}", firstUnit ? "" : ", ", unit,
+				fileHeader->TSCounts[channel][unit], fileHeader->WFCounts[channel][unit]);
+			total += fileHeader->TSCounts[channel][unit];
+			firstUnit = 0;
+		}
+		fprintf(file, "], \"timestamps\": %lld}", total);
+		spikes += total;
+	}
+	fprintf(file, "\n  ],\n");
+
+	fprintf(file, "  \"eventChannels\": [");
+	for (i = 0; i < fileHeader->NumEventChannels; i++) {
+
+		eventHeader = &reader->eventHeaders[i];
+		channel     = eventHeader->Channel;
+		total       = ((channel >= 0) && (channel < PLX_SUMMARY_SLOW_BASE)) ? fileHeader->EVCounts[channel] : 0;
+
+		fprintf(file, "%s\n    {\"channel\": %d, \"name\": ", (i > 0) ? "," : "", channel);
+		plxSummaryName(file, eventHeader->Name);
+		fprintf(file, ", \"count\": %lld}", total);
+		events += total;
+	}
+	fprintf(file, "\n  ],\n");
+
+	fprintf(file, "  \"slowChannels\": [");
+	for (i = 0; i < fileHeader->NumSlowChannels; i++) {
+
+		slowHeader = &reader->slowHeaders[i];
+		channel    = slowHeader->Channel;
+
+		fprintf(file, "%s\n    {\"channel\": %d, \"name\": ", (i > 0) ? "," : "", channel);
+		plxSummaryName(file, slowHeader->Name);
+		fprintf(file, ", \"adFreq\": %d, \"gain\": %d, \"enabled\": %d", slowHeader->ADFreq, slowHeader->Gain, slowHeader->Enabled);
+
+		// sample counters only exist for channels below 212
+		if ((channel >= 0) && (PLX_SUMMARY_SLOW_BASE + channel < PLX_SUMMARY_EVENTS)) {
+			fprintf(file, ", \"samples\": %d", fileHeader->EVCounts[PLX_SUMMARY_SLOW_BASE + channel]);
+		}
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n  ],\n");
+
+	fprintf(file, "  \"spikes\": %lld,\n", spikes);
+	fprintf(file, "  \"events\": %lld", events);
+
+	if (verify != NULL) {
+
+		fprintf(file, ",\n  \"verify\": {\n");
+		fprintf(file, "    \"blocks\": %lld,\n", verify->blocks);
+		fprintf(file, "    \"spikes\": %lld,\n", verify->spikes);
+		fprintf(file, "    \"events\": %lld,\n", verify->events);
+		fprintf(file, "    \"slowBlocks\": %lld,\n", verify->slowBlocks);
+		fprintf(file, "    \"slowSamples\": %lld,\n", verify->slowSamples);
+		fprintf(file, "    \"firstTimestamp\": %lld,\n", verify->firstTimestamp);
+		fprintf(file, "    \"lastTimestamp\": %lld,\n", verify->lastTimestamp);
+		fprintf(file, "    \"duration\": %.6f,\n", (fileHeader->ADFrequency > 0) ? (double) verify->lastTimestamp / fileHeader->ADFrequency : 0.0);
+		fprintf(file, "    \"truncated\": %s,\n", verify->truncated ? "true" : "false");
+
+		// header counters that differ from the blocks in the file
+		fprintf(file, "    \"mismatches\": [");
+		first = 1;
+		for (channel = 1; channel < PLX_SUMMARY_CHANNELS; channel++) {
+			for (unit = 0; unit < PLX_SUMMARY_UNITS; unit++) {
+				if (fileHeader->TSCounts[channel][unit] != verify->tsCounts[channel][unit]) {
+					plxSummaryMismatch(file, &first, "TSCounts", channel, unit, fileHeader->TSCounts[channel][unit], verify->tsCounts[channel][unit]);
+				}
+				if (fileHeader->WFCounts[channel][unit] != verify->wfCounts[channel][unit]) {
+					plxSummaryMismatch(file, &first, "WFCounts", channel, unit, fileHeader->WFCounts[channel][unit], verify->wfCounts[channel][unit]);
+				}
+			}
+		}
+		for (channel = 0; channel < PLX_SUMMARY_EVENTS; channel++) {
+			if (fileHeader->EVCounts[channel] != verify->evCounts[channel]) {
+				plxSummaryMismatch(file, &first, "EVCounts", channel, -1, fileHeader->EVCounts[channel], verify->evCounts[channel]);
+			}
+		}
+		fprintf(file, "%s]\n  }", first ? "" : "\n    ");
+	}
+
+	fprintf(file, "\n}\n");
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXSUMMARY_H__
+#define __PLXSUMMARY_H__
+
+#pragma once
+#include "plxreader.h"
+
+// Shape of the counters in PL_FileHeader
+#define PLX_SUMMARY_CHANNELS	130		// TSCounts/WFCounts channels (1-based)
+#define PLX_SUMMARY_UNITS		5		// TSCounts/WFCounts units
+#define PLX_SUMMARY_EVENTS		512		// EVCounts entries
+#define PLX_SUMMARY_SLOW_BASE	300		// EVCounts[300 + channel] holds continuous samples
+
+// Counts found by streaming the block headers (-verify). The arrays have
+// the shape of the file header counters, blocks outside of it are only
+// part of the totals.
+struct PlxSummaryVerify
+{
+	__int64 	blocks;
+	__int64 	spikes;
+	__int64 	events;
+	__int64 	slowBlocks;
+	__int64 	slowSamples;
+	__int64 	firstTimestamp;				// -1 without blocks
+	__int64 	lastTimestamp;
+	__int64 	tsCounts[PLX_SUMMARY_CHANNELS][PLX_SUMMARY_UNITS];
+	__int64 	wfCounts[PLX_SUMMARY_CHANNELS][PLX_SUMMARY_UNITS];
+	__int64 	evCounts[PLX_SUMMARY_EVENTS];
+	int 		truncated;
+};
+
+// Summary functions
+int  plxSummaryVerify(struct PlxSummaryVerify *verify, struct PlxReader *reader);
+void plxSummaryWrite(FILE *file, const struct PlxReader *reader, const char *fileName, const struct PlxSummaryVerify *verify);
+void plxSummaryString(FILE *file, const char *text, int maxLength);
+
+#endif
@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 by Gerold Bausch (mail@geroldbausch.de)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+#include "plxtrains.h"
+
+void plxTrainsInit(struct PlxTrains *trains, const struct PlxReader *reader)
+{
+	memset(trains, 0, sizeof(struct PlxTrains));
+	trains->fileHeader    = &reader->fileHeader;
+	trains->lastTimestamp = -1;
+}
+
+// Train of channel and unit, created on first use. NULL if out of memory.
+static struct PlxTrain *plxTrainsGet(struct PlxTrains *trains, int channel, int unit)
+{
+	struct PlxTrain *train, *resized;
+	int i, direct;
+
+	direct = (channel >= 0) && (channel < PLX_TRAINS_CHANNELS) && (unit >= 0) && (unit < PLX_TRAINS_UNITS);
+
+	if (direct) {
+		if (trains->lookup[channel][unit] > 0) return &trains->trains[trains->lookup[channel][unit] - 1];
+	} else {
+		for (i = 0; i < trains->numTrains; i++) {
+			if ((trains->trains[i].channel == channel) && (trains->trains[i].unit == unit)) return &trains->trains[i];
+		}
+	}
+
+	if (trains->numTrains == trains->capacity) {
+		resized = (struct PlxTrain*) realloc (trains->trains, (trains->capacity + 64) * sizeof(struct PlxTrain));
+		if (resized == NULL) return NULL;
+		trains->trains    = resized;
+		trains->capacity += 64;
+	}
+
+	train = &trains->trains[trains->numTrains];
+	memset(train, 0, sizeof(struct PlxTrain));
+	train->channel = (short) channel;
+	train->unit    = (short) unit;
+	train->sorted  = 1;
+
+	train->capacity = plxNpySpikeCount(trains->fileHeader, channel, unit);
+	if (train->capacity == 0) train->capacity = PLX_TRAINS_MIN_CAPACITY;
+
+	train->timestamps = (__int64*) malloc (train->capacity * sizeof(__int64));
+	if (train->timestamps == NULL) return NULL;
+
+	trains->numTrains++;
+	if (direct) trains->lookup[channel][unit] = trains->numTrains;
+
+	return train;
+}
+
+// Append the spike blocks of a batch to their trains
+void plxTrainsBatch(struct PlxTrains *trains, const struct PlxBatch *batch)
+{
+	struct PlxTrain *train = NULL;
+	__int64 *resized, timestamp;
+	int j;
+
+	for (j = 0; j < batch->count; j++) {
+
+		if (batch->type[j] != 1) continue;
+
+		// spikes of a unit often come in runs
+		if ((train == NULL) || (train->channel != batch->channel[j]) || (train->unit != batch->unit[j])) {
+			train = plxTrainsGet(trains, batch->channel[j], batch->unit[j]);
+			if (train == NULL) {
+				trains->error = 1;
+				return;
+			}
+		}
+
+		// header counters may be too small
+		if (train->count == train->capacity) {
+			resized = (__int64*) realloc (train->timestamps, 2 * train->capacity * sizeof(__int64));
+			if (resized == NULL) {
+				trains->error = 1;
+				return;
+			}
+			train->timestamps = resized;
+			train->capacity  *= 2;
+		}
+
+		timestamp = batch->timestamp[j];
+		if ((train->count > 0) && (timestamp < train->timestamps[train->count - 1])) train->sorted = 0;
+		train->timestamps[train->count++] = timestamp;
+
+		if (timestamp > trains->lastTimestamp) trains->lastTimestamp = timestamp;
+		trains->spikes++;
+	}
+}
+
+static int plxTrainsCompareTimestamps(const void *a, const void *b)
+{
+	__int64 x = *(const __int64*) a, y = *(const __int64*) b;
+	return (x > y) - (x < y);
+}
+
+static int plxTrainsCompareTrains(const void *a, const void *b)
+{
+	const struct PlxTrain *x = (const struct PlxTrain*) a, *y = (const struct PlxTrain*) b;
+
+	if (x->channel != y->channel) return x->channel - y->channel;
+	return x->unit - y->unit;
+}
+
+// Sort timestamps that arrived out of order and the trains by channel and
+// unit. No batches can be added afterwards.
+void plxTrainsFinish(struct PlxTrains *trains)
+{
+	int i;
+
+	for (i = 0; i < trains->numTrains; i++) {
+		if (!trains->trains[i].sorted) {
+			qsort(trains->trains[i].timestamps, trains->trains[i].count, sizeof(__int64), plxTrainsCompareTimestamps);
+			trains->trains[i].sorted = 1;
+		}
+	}
+
+	if (trains->numTrains > 1) qsort(trains->trains, trains->numTrains, sizeof(struct PlxTrain), plxTrainsCompareTrains);
+	memset(trains->lookup, 0, sizeof(trains->lookup));
+}
+
+// Write all trains back to back into <baseName>.trains.npy (int64 ticks)
+// and one row of channel, unit, first index and count per train into
+// <baseName>.trains.units.npy (int64)
+int plxTrainsWrite(const struct PlxTrains *trains, const char *baseName)
+{
+	struct PlxNpyColumn timestamps, units;
+	const struct PlxTrain *train;
+	__int64 *pUnit, start = 0, done, values;
+	__int64 maxValues = (__int64) (PLX_NPY_OUTBUF_SIZE / sizeof(__int64));
+	char *pTimestamps;
+	int i, error = 0;
+
+	memset(&timestamps, 0, sizeof(struct PlxNpyColumn));
+	memset(&units, 0, sizeof(struct PlxNpyColumn));
+
+	if ((plxNpyColumnOpen(&timestamps, baseName, "trains", "<i8", 0, sizeof(__int64), trains->spikes) != 0) ||
+		(plxNpyColumnOpen(&units, baseName, "trains.units", "<i8", 4, sizeof(__int64), trains->numTrains) != 0)) {
+		plxNpyColumnClose(&timestamps, 0);
+		plxNpyColumnClose(&units, 0);
+		return -1;
+	}
+
+	for (i = 0; (i < trains->numTrains) && !error; i++) {
+
+		train = &trains->trains[i];
+
+		// copy the train in pieces of at most one buffer
+		for (done = 0; done < train->count; done += values) {
+			values = train->count - done;
+			if (values > maxValues) values = maxValues;
+
+			pTimestamps = plxOutBufReserve(&timestamps.out, values * sizeof(__int64));
+			if (pTimestamps == NULL) break;
+			memcpy(pTimestamps, &train->timestamps[done], values * sizeof(__int64));
+			timestamps.out.used += values * sizeof(__int64);
+		}
+		if (done < train->count) {
+			error = 1;
+			break;
+		}
+
+		pUnit = (__int64*) plxOutBufReserve(&units.out, 4 * sizeof(__int64));
+		if (pUnit == NULL) {
+			error = 1;
+			break;
+		}
+		pUnit[0] = train->channel;
+		pUnit[1] = train->unit;
+		pUnit[2] = start;
+		pUnit[3] = train->count;
+		units.out.used += 4 * sizeof(__int64);
+
+		start += train->count;
+	}
+
+	if (plxNpyColumnClose(&timestamps, start) != 0) error = 1;
+	if (plxNpyColumnClose(&units, trains->numTrains) != 0) error = 1;
+
+	return error ? -1 : 0;
+}
+
+// Move the cursors to the first spike at or after origin
+static void plxTrainsSeek(const struct PlxTrains *trains, __int64 *cursors, __int64 origin)
+{
+	const struct PlxTrain *train;
+	int i;
+
+	for (i = 0; i < trains->numTrains; i++) {
+		train = &trains->trains[i];
+		cursors[i] = 0;
+		while ((cursors[i] < train->count) && (train->timestamps[cursors[i]] < origin)) cursors[i]++;
+	}
+}
+
+// Count the spikes of every train before end and advance the cursors
+// behind them. Returns the largest count.
+static int plxTrainsCountBin(const struct PlxTrains *trains, __int64 *cursors, __int64 end, int *row)
+{
+	const struct PlxTrain *train;
+	int i, maxCount = 0;
+
+	for (i = 0; i < trains->numTrains; i++) {
+		train  = &trains->trains[i];
+		row[i] = 0;
+		while ((cursors[i] < train->count) && (train->timestamps[cursors[i]] < end)) {
+			cursors[i]++;
+			row[i]++;
+		}
+		if (row[i] > maxCount) maxCount = row[i];
+	}
+
+	return maxCount;
+}
+
+// Write the spike counts per time bin as a matrix of numBins rows and one
+// column per train (order of <baseName>.trains.units.npy) into
+// <baseName>.trains.counts.npy. Bin i covers [origin + i * binTicks,
+// origin + (i + 1) * binTicks). The counts are stored in the narrowest
+// type that holds the largest one (uint8, uint16 or int32), found by a
+// first pass over the trains. Rows are streamed, memory stays at one row
+// and a cursor per train.
+int plxTrainsWriteCounts(const struct PlxTrains *trains, const char *baseName, __int64 origin, __int64 binTicks, __int64 numBins)
+{
+	struct PlxNpyColumn counts;
+	__int64 *cursors, bin;
+	int *row, i, width, valueBytes, maxCount = 0, count, error = 0;
+	const char *descr;
+	char *pRow;
+
+	memset(&counts, 0, sizeof(struct PlxNpyColumn));
+
+	// a matrix without columns has no rows either
+	if (trains->numTrains == 0) numBins = 0;
+
+	width   = (trains->numTrains > 0) ? trains->numTrains : 1;
+	cursors = (__int64*) calloc (width, sizeof(__int64));
+	row     = (int*) calloc (width, sizeof(int));
+	if ((cursors == NULL) || (row == NULL)) {
+		free(cursors);
+		free(row);
+		return PLX_ERR_MEMORY;
+	}
+
+	plxTrainsSeek(trains, cursors, origin);
+	for (bin = 0; bin < numBins; bin++) {
+		count = plxTrainsCountBin(trains, cursors, origin + (bin + 1) * binTicks, row);
+		if (count > maxCount) maxCount = count;
+	}
+
+	if (maxCount <= 0xFF) {
+		descr      = "|u1";
+		valueBytes = 1;
+	} else if (maxCount <= 0xFFFF) {
+		descr      = "<u2";
+		valueBytes = 2;
+	} else {
+		descr      = "<i4";
+		valueBytes = 4;
+	}
+
+	if (plxNpyColumnOpen(&counts, baseName, "trains.counts", descr, trains->numTrains, valueBytes, numBins) != 0) {
+		plxNpyColumnClose(&counts, 0);
+		free(cursors);
+		free(row);
+		return -1;
+	}
+
+	plxTrainsSeek(trains, cursors, origin);
+	for (bin = 0; bin < numBins; bin++) {
+
+		plxTrainsCountBin(trains, cursors, origin + (bin + 1) * binTicks, row);
+
+		pRow = plxOutBufReserve(&counts.out, counts.rowBytes);
+		if (pRow == NULL) {
+			error = 1;
+			break;
+		}
+
+		if (valueBytes == 1) {
+			for (i = 0; i < trains->numTrains; i++) ((unsigned char*) pRow)[i] = (unsigned char) row[i];
+		} else if (valueBytes == 2) {
+			for (i = 0; i < trains->numTrains; i++) ((unsigned short*) pRow)[i] = (unsigned short) row[i];
+		} else {
+			memcpy(pRow, row, trains->numTrains * sizeof(int));
+		}
+		counts.out.used += counts.rowBytes;
+	}
+
+	if (plxNpyColumnClose(&counts, error ? 0 : numBins) != 0) error = 1;
+	free(cursors);
+	free(row);
+
+	return error ? -1 : 0;
+}
+
+void plxTrainsFree(struct PlxTrains *trains)
+{
+	int i;
+
+	for (i = 0; i < trains->numTrains; i++) free(trains->trains[i].timestamps);
+	free(trains->trains);
+
+	trains->trains    = NULL;
+	trains->numTrains = 0;
+	trains->capacity  = 0;
+}
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// BEGIN LICENSE
+//
+// Copyright (c) 2011 Gerold Bausch
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// END LICENSE
+///////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __PLXTRAINS_H__
+#define __PLXTRAINS_H__
+
+#pragma once
+#include "plxdecode.h"
+#include "plxnpy.h"
+
+// Direct lookup of (channel, unit), trains outside of it are searched
+#define PLX_TRAINS_CHANNELS		256
+#define PLX_TRAINS_UNITS		32
+
+// Initial capacity of a train without header counter
+#define PLX_TRAINS_MIN_CAPACITY	1024
+
+// Spike timestamps of one channel and unit
+struct PlxTrain
+{
+	short 		channel;
+	short 		unit;
+	__int64 	*timestamps;			// ticks
+	__int64 	count;
+	__int64 	capacity;
+	int 		sorted;					// timestamps arrived in order
+};
+
+// Spike trains of all channels and units, collected from batches of spike
+// blocks (-trains). A train is presized from TSCounts when its first spike
+// arrives, so trains of filtered units cost nothing.
+struct PlxTrains
+{
+	struct PlxTrain *trains;
+	int 		numTrains;
+	int 		capacity;
+	int 		lookup[PLX_TRAINS_CHANNELS][PLX_TRAINS_UNITS];	// index + 1 into trains, 0: none yet
+	const struct PL_FileHeader *fileHeader;
+	__int64 	spikes;
+	__int64 	lastTimestamp;			// -1 without spikes
+	int 		error;					// out of memory
+};
+
+// Spike train functions
+void plxTrainsInit(struct PlxTrains *trains, const struct PlxReader *reader);
+void plxTrainsBatch(struct PlxTrains *trains, const struct PlxBatch *batch);
+void plxTrainsFinish(struct PlxTrains *trains);
+int  plxTrainsWrite(const struct PlxTrains *trains, const char *baseName);
+int  plxTrainsWriteCounts(const struct PlxTrains *trains, const char *baseName, __int64 origin, __int64 binTicks, __int64 numBins);
+void plxTrainsFree(struct PlxTrains *trains);
+
+#endif